@@ -0,0 +1,445 @@
+/*
+  ==============================================================================
+
+    This file contains the basic startup code for a JUCE application.
+
+    Measures the cost of every DSP class and of the full processBlock() in
+    nanoseconds per sample, at several sample rates and block sizes, and
+    writes the results as JSON for regression tracking.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../Source/PluginProcessor.h"
+#include "../../Source/Oscillators.h"
+#include "../../Source/PadSynth.h"
+#include "../../Source/PadSynthBank.h"
+#include "../../Source/StringSynth.h"
+#include "../../Source/Subbass.h"
+#include "../../Source/Movement.h"
+#include "../../Source/FrequencySelector.h"
+#include "../../Source/StateVariableFilter.h"
+#include "../../Source/FDNReverb.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace
+{
+    // Renders one block of numSamples samples into out
+    using BlockFunction = std::function<void (float* out, int numSamples)>;
+
+    /** A named piece of DSP to measure.
+
+        prepare() builds and configures a fresh instance for a sample rate and block size, and returns the function that renders one block with it. The instance lives as long as the returned function.
+    */
+    struct Benchmark
+    {
+        juce::String name;
+        int numVoices; // voices rendered by one call, so the cost can be reported per voice
+        std::function<BlockFunction (float sampleRate, int blockSize)> prepare;
+    };
+
+    struct Result
+    {
+        juce::String name;
+        float sampleRate;
+        int blockSize;
+        juce::int64 numSamples;  // samples rendered in the timed runs
+        double nsPerSample;      // median over the runs, per voice
+        double voicesPerCore;    // voices one core can render in real time
+    };
+
+    // Wraps a class with a per-sample process() into a block function
+    template <typename DSP>
+    BlockFunction perSample(std::shared_ptr<DSP> dsp)
+    {
+        return [dsp] (float* out, int numSamples)
+        {
+            for (int i = 0; i < numSamples; ++i)
+                out[i] = dsp->process();
+        };
+    }
+
+    // Wraps a reverb with juce::Reverb's interface into a block function that processes a stereo pair of noise
+    template <typename ReverbType>
+    BlockFunction stereoReverb(float sampleRate, int blockSize)
+    {
+        auto reverb = std::make_shared<ReverbType>();
+        reverb->setSampleRate(sampleRate);
+        juce::Reverb::Parameters parameters;
+        parameters.dryLevel = 0.5f;
+        parameters.wetLevel = 0.05f;
+        parameters.roomSize = 0.9f;
+        reverb->setParameters(parameters);
+
+        auto right = std::make_shared<std::vector<float>>((size_t) blockSize);
+        auto random = std::make_shared<juce::Random>(1);
+        return [reverb, right, random] (float* out, int numSamples)
+        {
+            for (int i = 0; i < numSamples; ++i)
+            {
+                out[i] = random->nextFloat() * 0.2f - 0.1f;
+                (*right)[(size_t) i] = out[i];
+            }
+            reverb->processStereo(out, right->data(), numSamples);
+        };
+    }
+
+    std::vector<Benchmark> createBenchmarks()
+    {
+        std::vector<Benchmark> benchmarks;
+
+        for (auto backend : { SineBackend::Precise, SineBackend::Wavetable, SineBackend::Polynomial })
+        {
+            for (auto isFixedPoint : { false, true })
+            {
+                juce::String backendName = backend == SineBackend::Precise ? "Precise"
+                                         : backend == SineBackend::Wavetable ? "Wavetable" : "Polynomial";
+                if (isFixedPoint)
+                    backendName += "/FixedPoint";
+
+                benchmarks.push_back({ "SinOsc::process/" + backendName, 1, [backend, isFixedPoint] (float sampleRate, int)
+                {
+                    auto osc = std::make_shared<SinOsc>();
+                    osc->setBackend(backend);
+                    osc->setFixedPointPhase(isFixedPoint);
+                    osc->setSampleRate(sampleRate);
+                    osc->setFrequency(440.0f);
+                    return perSample(osc);
+                }});
+
+                benchmarks.push_back({ "SinOsc::processBlock/" + backendName, 1, [backend, isFixedPoint] (float sampleRate, int)
+                {
+                    auto osc = std::make_shared<SinOsc>();
+                    osc->setBackend(backend);
+                    osc->setFixedPointPhase(isFixedPoint);
+                    osc->setSampleRate(sampleRate);
+                    osc->setFrequency(440.0f);
+                    return BlockFunction ([osc] (float* out, int numSamples) { osc->processBlock(out, numSamples); });
+                }});
+            }
+        }
+
+        benchmarks.push_back({ "SawOsc::processBlock", 1, [] (float sampleRate, int)
+        {
+            auto osc = std::make_shared<SawOsc>();
+            osc->setSampleRate(sampleRate);
+            osc->setFrequency(110.0f);
+            return BlockFunction ([osc] (float* out, int numSamples) { osc->processBlock(out, numSamples); });
+        }});
+
+        benchmarks.push_back({ "PolyBlepSawOsc::processBlock", 1, [] (float sampleRate, int)
+        {
+            auto osc = std::make_shared<PolyBlepSawOsc>();
+            osc->setSampleRate(sampleRate);
+            osc->setFrequency(110.0f);
+            return BlockFunction ([osc] (float* out, int numSamples) { osc->processBlock(out, numSamples); });
+        }});
+
+        benchmarks.push_back({ "PolyBlepSquareOsc::process/PWM", 1, [] (float sampleRate, int)
+        {
+            auto osc = std::make_shared<PolyBlepSquareOsc>();
+            osc->setSampleRate(sampleRate);
+            osc->setFrequency(110.0f);
+            auto pulseWidth = std::make_shared<float>(0.0f);
+            return BlockFunction ([osc, pulseWidth] (float* out, int numSamples)
+            {
+                for (int i = 0; i < numSamples; ++i)
+                {
+                    *pulseWidth = *pulseWidth < 0.5f ? *pulseWidth + 1.0e-5f : 0.0f;
+                    osc->setPulseWidth(*pulseWidth);
+                    out[i] = osc->process();
+                }
+            });
+        }});
+
+        benchmarks.push_back({ "StateVariableFilter::processSample", 1, [] (float sampleRate, int)
+        {
+            auto filter = std::make_shared<StateVariableFilter>();
+            filter->setSampleRate(sampleRate);
+            filter->setType(StateVariableFilter::Type::HighPass);
+            filter->setResonance(5.0f);
+            filter->setCutOff(2000.0f);
+            return BlockFunction ([filter] (float* out, int numSamples)
+            {
+                for (int i = 0; i < numSamples; ++i)
+                    out[i] = filter->processSample(out[i] + 0.1f);
+            });
+        }});
+
+        benchmarks.push_back({ "PadSynth::process", 1, [] (float sampleRate, int)
+        {
+            auto pad = std::make_shared<PadSynth>();
+            pad->setSampleRate(sampleRate);
+            pad->setFrequency(349.23f);
+            pad->setLFOFrequency(3.0f);
+            pad->setLFOAmount(0.125f);
+            pad->setFilterCutOff(5000.0f);
+            return perSample(pad);
+        }});
+
+        // Voices at a 0 Hz rest, after their fade-out, cost next to nothing
+        benchmarks.push_back({ "PadSynth::process/rest", 1, [] (float sampleRate, int)
+        {
+            auto pad = std::make_shared<PadSynth>();
+            pad->setSampleRate(sampleRate);
+            pad->setFrequency(0.0f);
+            return perSample(pad);
+        }});
+
+        benchmarks.push_back({ "StringSynth::process/rest", 1, [] (float sampleRate, int)
+        {
+            auto string = std::make_shared<StringSynth>();
+            string->setSampleRate(sampleRate);
+            string->setFrequency(0.0f);
+            return perSample(string);
+        }});
+
+        benchmarks.push_back({ "PadSynthBank<16>::process", 16, [] (float sampleRate, int)
+        {
+            auto bank = std::make_shared<PadSynthBank<16>>();
+            bank->setSampleRate(sampleRate);
+            for (int v = 0; v < bank->getNumVoices(); ++v)
+                bank->setFrequency(v, 220.0f + 20.0f * v);
+            bank->setLFOFrequency(3.0f);
+            bank->setLFOAmount(0.125f);
+            bank->setFilterCutOff(5000.0f);
+            return BlockFunction ([bank] (float* out, int numSamples) { bank->process(out, numSamples); });
+        }});
+
+        benchmarks.push_back({ "StringSynth::process", 1, [] (float sampleRate, int)
+        {
+            auto string = std::make_shared<StringSynth>();
+            string->setSampleRate(sampleRate);
+            string->setFrequency(261.63f);
+            string->setVibratoFreq(5.0f);
+            string->setVibratoAmount(0.005f);
+            return perSample(string);
+        }});
+
+        benchmarks.push_back({ "Subbass::process", 1, [] (float sampleRate, int)
+        {
+            auto subbass = std::make_shared<Subbass>();
+            subbass->setSampleRate(sampleRate);
+            subbass->setFrequency(87.31f);
+            return perSample(subbass);
+        }});
+
+        benchmarks.push_back({ "Movement::process", 1, [] (float sampleRate, int)
+        {
+            auto movement = std::make_shared<Movement>();
+            movement->setSampleRate(sampleRate);
+            movement->setFrequency(5.0f);
+            movement->setVibratoFreq(1.0f);
+            return perSample(movement);
+        }});
+
+        benchmarks.push_back({ "FrequencySelector::process", 1, [] (float sampleRate, int)
+        {
+            auto selector = std::make_shared<FrequencySelector>();
+            FrequencySelector::Parameters parameters;
+            parameters.sampleRate = sampleRate;
+            parameters.setFrequencies({1046.52f, 1568.0f, 0.0f, 0.0f});
+            parameters.holdDuration = 0.4f;
+            selector->setParameters(parameters);
+            return perSample(selector);
+        }});
+
+        benchmarks.push_back({ "juce::Reverb::processStereo", 1, stereoReverb<juce::Reverb> });
+        benchmarks.push_back({ "FDNReverb::processStereo", 1, stereoReverb<FDNReverb> });
+
+        benchmarks.push_back({ "AP_Assignment2AudioProcessor::processBlock", 1, [] (float sampleRate, int blockSize)
+        {
+            auto processor = std::make_shared<AP_Assignment2AudioProcessor>();
+            processor->setNonRealtime(true);
+            processor->setPlayConfigDetails(processor->getTotalNumInputChannels(), processor->getTotalNumOutputChannels(),
+                                            sampleRate, blockSize);
+            processor->prepareToPlay(sampleRate, blockSize);
+
+            auto buffer = std::make_shared<juce::AudioBuffer<float>>(juce::jmax(2, processor->getTotalNumOutputChannels()), blockSize);
+            auto midiMessages = std::make_shared<juce::MidiBuffer>();
+            return BlockFunction ([processor, buffer, midiMessages] (float* out, int numSamples)
+            {
+                buffer->setSize(buffer->getNumChannels(), numSamples, false, false, true);
+                processor->processBlock(*buffer, *midiMessages);
+                out[0] = buffer->getSample(0, 0);
+            });
+        }});
+
+        // Dense host automation: a cutoff sweep with a CC 74 message every 4 samples, which the minimum sub-block
+        // size gathers into spans of at least 32 samples
+        benchmarks.push_back({ "AP_Assignment2AudioProcessor::processBlock/automation", 1, [] (float sampleRate, int blockSize)
+        {
+            auto processor = std::make_shared<AP_Assignment2AudioProcessor>();
+            processor->setNonRealtime(true);
+            processor->setPlayConfigDetails(processor->getTotalNumInputChannels(), processor->getTotalNumOutputChannels(),
+                                            sampleRate, blockSize);
+            processor->setMinimumSubBlockSize(32);
+            processor->prepareToPlay(sampleRate, blockSize);
+
+            auto buffer = std::make_shared<juce::AudioBuffer<float>>(juce::jmax(2, processor->getTotalNumOutputChannels()), blockSize);
+            auto midiMessages = std::make_shared<juce::MidiBuffer>();
+            for (int i = 0; i < blockSize; i += 4)
+                midiMessages->addEvent(juce::MidiMessage::controllerEvent(1, 74, i * 127 / blockSize), i);
+
+            return BlockFunction ([processor, buffer, midiMessages] (float* out, int numSamples)
+            {
+                buffer->setSize(buffer->getNumChannels(), numSamples, false, false, true);
+                processor->processBlock(*buffer, *midiMessages);
+                out[0] = buffer->getSample(0, 0);
+            });
+        }});
+
+        return benchmarks;
+    }
+
+    // Times whole blocks until each run lasts about runSeconds, and returns the median cost per sample
+    Result run(const Benchmark& benchmark, float sampleRate, int blockSize, double runSeconds, int numRuns)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        auto process = benchmark.prepare(sampleRate, blockSize);
+        std::vector<float> block ((size_t) blockSize, 0.0f);
+
+        auto timeBlocks = [&] (juce::int64 numBlocks)
+        {
+            auto start = Clock::now();
+            for (juce::int64 b = 0; b < numBlocks; ++b)
+                process(block.data(), blockSize);
+            return std::chrono::duration<double>(Clock::now() - start).count();
+        };
+
+        // Warm up, then find how many blocks make a run of the requested length
+        juce::int64 numBlocks = 1;
+        for (auto elapsed = timeBlocks(numBlocks); elapsed < runSeconds * 0.1; elapsed = timeBlocks(numBlocks))
+            numBlocks *= 2;
+        numBlocks = juce::jmax((juce::int64) 1, (juce::int64) (numBlocks * runSeconds / juce::jmax(1.0e-9, timeBlocks(numBlocks))));
+
+        std::vector<double> nsPerSample;
+        for (int r = 0; r < numRuns; ++r)
+            nsPerSample.push_back(timeBlocks(numBlocks) * 1.0e9 / (double) (numBlocks * blockSize * benchmark.numVoices));
+
+        std::sort(nsPerSample.begin(), nsPerSample.end());
+        auto median = nsPerSample[nsPerSample.size() / 2];
+
+        // Keep the output alive so the work cannot be optimised away
+        static volatile float sink = 0.0f;
+        sink = sink + block[0];
+
+        return { benchmark.name, sampleRate, blockSize, numBlocks * blockSize * numRuns, median, 1.0e9 / (sampleRate * median) };
+    }
+
+    juce::var toJSON(const std::vector<Result>& results)
+    {
+        auto* context = new juce::DynamicObject();
+        context->setProperty("date", juce::Time::getCurrentTime().toISO8601(true));
+        context->setProperty("cpu", juce::SystemStats::getCpuModel());
+        context->setProperty("numCpus", juce::SystemStats::getNumCpus());
+        context->setProperty("mhzPerCpu", juce::SystemStats::getCpuSpeedInMegahertz());
+       #if JUCE_DEBUG
+        context->setProperty("build", "Debug");
+       #else
+        context->setProperty("build", "Release");
+       #endif
+
+        juce::Array<juce::var> entries;
+        for (auto& result : results)
+        {
+            auto* entry = new juce::DynamicObject();
+            entry->setProperty("name", result.name);
+            entry->setProperty("sampleRate", result.sampleRate);
+            entry->setProperty("blockSize", result.blockSize);
+            entry->setProperty("samples", result.numSamples);
+            entry->setProperty("nsPerSample", result.nsPerSample);
+            entry->setProperty("voicesPerCore", result.voicesPerCore);
+            entries.add(juce::var(entry));
+        }
+
+        auto* root = new juce::DynamicObject();
+        root->setProperty("context", juce::var(context));
+        root->setProperty("benchmarks", entries);
+        return juce::var(root);
+    }
+
+    // Prints the command line usage
+    void printUsage()
+    {
+        std::cout << "Usage: WanderingInCycleBenchmarks [options]" << std::endl
+                  << std::endl
+                  << "  --filter <text>     Only run benchmarks whose name contains text" << std::endl
+                  << "  --json <file>       Write the results as JSON to file ('-' for stdout)" << std::endl
+                  << "  --run-time <s>      Length of each timed run, defaulting to 0.05" << std::endl
+                  << "  --runs <n>          Timed runs per measurement, the median is reported, defaulting to 5" << std::endl;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    // The processor's parameter tree starts timers, which need the message manager
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args (argc, argv);
+
+    if (args.containsOption("--help|-h"))
+    {
+        printUsage();
+        return 0;
+    }
+
+    auto filter = args.getValueForOption("--filter");
+    auto jsonPath = args.getValueForOption("--json");
+    auto runSeconds = args.containsOption("--run-time") ? args.getValueForOption("--run-time").getDoubleValue() : 0.05;
+    auto numRuns = args.containsOption("--runs") ? juce::jmax(1, args.getValueForOption("--runs").getIntValue()) : 5;
+    auto writeJSONToStdout = jsonPath == "-";
+
+    const float sampleRates[] = { 44100.0f, 48000.0f, 96000.0f, 192000.0f };
+    const int blockSizes[] = { 32, 128, 512, 2048 };
+
+    std::vector<Result> results;
+    for (auto& benchmark : createBenchmarks())
+    {
+        if (filter.isNotEmpty() && ! benchmark.name.contains(filter))
+            continue;
+
+        for (auto sampleRate : sampleRates)
+        {
+            for (auto blockSize : blockSizes)
+            {
+                results.push_back(run(benchmark, sampleRate, blockSize, runSeconds, numRuns));
+                auto& result = results.back();
+
+                if (! writeJSONToStdout)
+                    std::cout << std::left << std::setw(48) << result.name.toRawUTF8()
+                              << std::right << std::setw(8) << (int) sampleRate << " Hz"
+                              << std::setw(6) << blockSize << " samples"
+                              << std::fixed << std::setprecision(2)
+                              << std::setw(10) << result.nsPerSample << " ns/sample"
+                              << std::setprecision(1)
+                              << std::setw(10) << result.voicesPerCore << " voices/core" << std::endl;
+            }
+        }
+    }
+
+    if (jsonPath.isNotEmpty())
+    {
+        auto json = juce::JSON::toString(toJSON(results));
+
+        if (writeJSONToStdout)
+        {
+            std::cout << json << std::endl;
+        }
+        else if (! juce::File::getCurrentWorkingDirectory().getChildFile(jsonPath).replaceWithText(json))
+        {
+            std::cerr << "Error: cannot write " << jsonPath << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,478 @@
+/*
+  ==============================================================================
+
+    This file contains the basic startup code for a JUCE application.
+
+    Renders the piece offline, without an audio device or a GUI, and streams
+    the result to a WAV or FLAC file in constant memory.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../Source/PluginProcessor.h"
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+    // Prints the command line usage
+    void printUsage()
+    {
+        std::cout << "Usage: WanderingInCycleRender [options] <output.wav|output.flac>" << std::endl
+                  << "       WanderingInCycleRender --convert-score <score.txt> <output.score>" << std::endl
+                  << std::endl
+                  << "  --length, -l <seconds>       Length of the render, defaulting to 600" << std::endl
+                  << "  --sample-rate, -r <Hz>       Sample rate, defaulting to 48000" << std::endl
+                  << "  --block-size, -b <samples>   Samples per processBlock() call, defaulting to 512" << std::endl
+                  << "  --bits <16|24|32>            Bit depth, defaulting to 24 (32 is float, WAV only)" << std::endl
+                  << "  --workers <n>                Worker threads for the layers, defaulting to 0 (audio thread only)" << std::endl
+                  << "  --pipelined-reverb           Runs the reverb on its own thread, one block behind" << std::endl
+                  << "  --fixed-point-phase          Keeps oscillator phases in fixed point, so they never drift" << std::endl
+                  << "  --seed <n>                   Seed of the random note choices; the same seed renders the same file" << std::endl
+                  << "  --patch <file.json>          Modulation patch to play instead of the built-in one" << std::endl
+                  << "  --score <file.score>         Binary score whose layers replace the built-in sequences" << std::endl
+                  << "  --jobs <n>                   Segments rendered at once, each on its own processor, defaulting to 1" << std::endl
+                  << "  --check-jobs <dB>            Renders again on one job, and fails if the files differ by more than dB" << std::endl;
+    }
+
+    // Returns the value of an option, or fallback when the option is missing
+    juce::String getOption(const juce::ArgumentList& args, juce::StringRef option, juce::StringRef fallback)
+    {
+        return args.containsOption(option) ? args.getValueForOption(option) : juce::String(fallback);
+    }
+
+    // Picks the audio format from the file extension
+    std::unique_ptr<juce::AudioFormat> createFormatFor(const juce::File& file)
+    {
+        if (file.hasFileExtension("wav"))
+            return std::make_unique<juce::WavAudioFormat>();
+        if (file.hasFileExtension("flac"))
+            return std::make_unique<juce::FlacAudioFormat>();
+        return nullptr;
+    }
+
+    // Prints an error and returns the exit code for a failed render
+    int fail(const juce::String& message)
+    {
+        std::cerr << "Error: " << message << std::endl;
+        return 1;
+    }
+
+    // Converts a text score into the binary format the plugin plays
+    int convertScore(const juce::File& textFile, const juce::File& outputFile)
+    {
+        if (! textFile.existsAsFile())
+            return fail("cannot read " + textFile.getFullPathName());
+
+        juce::MemoryBlock binary;
+        auto result = Score::convertText(textFile.loadFileAsString(), binary);
+        if (result.failed())
+            return fail(textFile.getFullPathName() + ": " + result.getErrorMessage());
+
+        if (! outputFile.replaceWithData(binary.getData(), binary.getSize()))
+            return fail("cannot write " + outputFile.getFullPathName());
+
+        std::cout << "Wrote " << (int) binary.getSize() << " bytes to " << outputFile.getFullPathName() << std::endl;
+        return 0;
+    }
+
+    // How every processor of a render is set up
+    struct RenderSettings
+    {
+        double sampleRate = 48000.0;
+        int blockSize = 512;
+        int numWorkers = 0;
+        bool pipelinedReverb = false;
+        bool fixedPointPhase = false;
+        bool hasSeed = false;
+        juce::uint64 seed = 0;
+        juce::String patch;     // JSON of the modulation patch, empty for the built-in one
+        juce::File score;       // binary score, none for the built-in sequences
+    };
+
+    // Sets a processor up for an offline render
+    void prepareProcessor(AP_Assignment2AudioProcessor& processor, const RenderSettings& settings)
+    {
+        processor.setNonRealtime(true);
+        processor.setNumWorkerThreads(settings.numWorkers);
+        processor.setReverbPipelined(settings.pipelinedReverb);
+        processor.setFixedPointPhase(settings.fixedPointPhase);
+        if (settings.hasSeed)
+            processor.setRandomSeed(settings.seed);
+        if (settings.patch.isNotEmpty())
+            processor.setModulationPatch(settings.patch);
+        if (settings.score != juce::File())
+            processor.loadScore(settings.score);
+        processor.setPlayConfigDetails(processor.getTotalNumInputChannels(), processor.getTotalNumOutputChannels(),
+                                       settings.sampleRate, settings.blockSize);
+        processor.prepareToPlay(settings.sampleRate, settings.blockSize);
+    }
+
+    // Prints how much of the render is done, every 10%
+    class Progress
+    {
+    public:
+        explicit Progress(juce::int64 numSamplesInTotal)
+            : total(numSamplesInTotal), step(juce::jmax((juce::int64) 1, numSamplesInTotal / 10)), next(step)
+        {
+        }
+
+        void add(juce::int64 numSamples)
+        {
+            done += numSamples;
+            if (done >= next)
+            {
+                std::cout << "  " << (int) (100 * done / total) << "%" << std::endl;
+                next += step;
+            }
+        }
+
+    private:
+        juce::int64 total, step, next, done = 0;
+    };
+
+    // Renders the piece from start to end on one processor, streaming it block by block
+    int renderInOrder(juce::AudioFormatWriter& writer, const RenderSettings& settings, juce::int64 numSamplesInFile)
+    {
+        AP_Assignment2AudioProcessor processor;
+        prepareProcessor(processor, settings);
+
+        // One block of audio is all that is held in memory
+        auto numChannels = juce::jmax(processor.getTotalNumInputChannels(), processor.getTotalNumOutputChannels());
+        juce::AudioBuffer<float> buffer (numChannels, settings.blockSize);
+        juce::MidiBuffer midiMessages;
+
+        // The processor's latency is rendered on top and cut from the start, so the file begins at time zero
+        auto latency = (juce::int64) processor.getLatencySamples();
+        auto totalSamples = numSamplesInFile + latency;
+        Progress progress (totalSamples);
+
+        for (juce::int64 rendered = 0; rendered < totalSamples;)
+        {
+            auto numSamples = (int) juce::jmin((juce::int64) settings.blockSize, totalSamples - rendered);
+
+            // The last block may be shorter; keep the allocation and only change the size
+            buffer.setSize(numChannels, numSamples, false, false, true);
+            buffer.clear();
+            processor.processBlock(buffer, midiMessages);
+
+            auto numToSkip = (int) juce::jlimit((juce::int64) 0, (juce::int64) numSamples, latency - rendered);
+            if (! writer.writeFromAudioSampleBuffer(buffer, numToSkip, numSamples - numToSkip))
+                return 1;
+
+            rendered += numSamples;
+            progress.add(numSamples);
+        }
+
+        processor.releaseResources();
+        return 0;
+    }
+
+    // ============================== parallel render ==============================
+    // The file is cut into segments, and each job renders every numJobs-th of them on its own processor, seeking
+    // over the segments of the other jobs. A seek rebuilds the notes and oscillators in closed form and renders the
+    // reverb's tail before the segment, so the segments join up. Each one runs on into the next by a short overlap,
+    // and the joins are crossfaded over it to hide what rounding is left.
+    constexpr double segmentSeconds = 60.0;
+    constexpr double overlapSeconds = 0.05;
+
+    // The audio of one segment, handed from a job to the writer and back
+    struct Segment
+    {
+        juce::AudioBuffer<float> audio;     // the segment, followed by the overlap into the next one
+        juce::WaitableEvent rendered;       // the job has filled audio
+        juce::WaitableEvent written;        // the writer is done with audio
+    };
+
+    class RenderJob : public juce::Thread
+    {
+    public:
+        RenderJob(int jobIndex, int numberOfJobs, const RenderSettings& renderSettings, juce::int64 numSamplesInFile)
+            : juce::Thread("Render job"), index(jobIndex), numJobs(numberOfJobs), settings(renderSettings),
+              totalSamples(numSamplesInFile)
+        {
+        }
+
+        ~RenderJob() override
+        {
+            signalThreadShouldExit();
+            segment.written.signal();
+            stopThread(-1);
+        }
+
+        Segment segment;
+
+    private:
+        int index, numJobs;
+        RenderSettings settings;
+        juce::int64 totalSamples;
+
+        void run() override
+        {
+            AP_Assignment2AudioProcessor processor;
+            prepareProcessor(processor, settings);
+            processor.setSeekPreRoll(processor.getTailLengthSeconds());
+
+            juce::AudioBuffer<float> buffer (2, settings.blockSize);
+            juce::MidiBuffer midiMessages;
+
+            auto segmentLength = (juce::int64) std::llround(segmentSeconds * settings.sampleRate);
+            auto overlap = (juce::int64) std::llround(overlapSeconds * settings.sampleRate);
+
+            for (auto start = index * segmentLength; start < totalSamples; start += numJobs * segmentLength)
+            {
+                auto isLast = start + segmentLength >= totalSamples;
+                auto length = (int) (isLast ? totalSamples - start : segmentLength + overlap);
+                segment.audio.setSize(2, length, false, false, true);
+
+                // The output runs the processor's latency behind its input, so the input seeks that much further
+                processor.seekTo(start + processor.getLatencySamples());
+
+                for (int rendered = 0; rendered < length;)
+                {
+                    auto numSamples = juce::jmin(settings.blockSize, length - rendered);
+                    buffer.setSize(2, numSamples, false, false, true);
+                    buffer.clear();
+                    processor.processBlock(buffer, midiMessages);
+                    for (int channel = 0; channel < 2; ++channel)
+                        segment.audio.copyFrom(channel, rendered, buffer, channel, 0, numSamples);
+                    rendered += numSamples;
+                }
+
+                segment.rendered.signal();
+                segment.written.wait();
+                if (threadShouldExit())
+                    break;
+            }
+
+            processor.releaseResources();
+        }
+    };
+
+    // Renders the piece as segments on numJobs threads at once, and writes them in order
+    int renderInParallel(juce::AudioFormatWriter& writer, const RenderSettings& settings, juce::int64 numSamplesInFile, int numJobs)
+    {
+        juce::OwnedArray<RenderJob> jobs;
+        for (int i = 0; i < numJobs; ++i)
+            jobs.add(new RenderJob(i, numJobs, settings, numSamplesInFile))->startThread();
+
+        auto segmentLength = (juce::int64) std::llround(segmentSeconds * settings.sampleRate);
+        auto overlap = (int) std::llround(overlapSeconds * settings.sampleRate);
+        juce::AudioBuffer<float> tail (2, overlap);    // the previous segment's overlap into the current one
+        Progress progress (numSamplesInFile);
+
+        for (juce::int64 start = 0, index = 0; start < numSamplesInFile; start += segmentLength, ++index)
+        {
+            auto& segment = jobs[(int) (index % numJobs)]->segment;
+            segment.rendered.wait();
+
+            auto& audio = segment.audio;
+            auto length = (int) juce::jmin(segmentLength, numSamplesInFile - start);
+
+            // Fade from the previous segment into this one
+            if (start > 0)
+            {
+                for (int channel = 0; channel < 2; ++channel)
+                {
+                    auto* samples = audio.getWritePointer(channel);
+                    auto* previous = tail.getReadPointer(channel);
+                    for (int i = 0; i < juce::jmin(overlap, length); ++i)
+                    {
+                        auto fade = ((float) i + 0.5f) / (float) overlap;
+                        samples[i] = previous[i] + fade * (samples[i] - previous[i]);
+                    }
+                }
+            }
+
+            if (! writer.writeFromAudioSampleBuffer(audio, 0, length))
+                return 1;
+
+            if (audio.getNumSamples() >= length + overlap)
+                for (int channel = 0; channel < 2; ++channel)
+                    tail.copyFrom(channel, 0, audio, channel, length, overlap);
+
+            segment.written.signal();
+            progress.add(length);
+        }
+
+        return 0;
+    }
+
+    // Renders the piece again on one job, into a temporary file, and compares it with the render in outputFile.
+    // Fails when their largest difference lies above maxDifferenceDecibels, relative to full scale.
+    int checkAgainstOneJob(const juce::File& outputFile, const RenderSettings& settings, juce::int64 numSamplesInFile,
+                           double maxDifferenceDecibels)
+    {
+        // The reference is kept in 32-bit float, so only the bit depth of the output file adds to the difference
+        juce::TemporaryFile reference (".wav");
+        auto stream = std::make_unique<juce::FileOutputStream>(reference.getFile());
+        if (stream->failedToOpen())
+            return fail("cannot open " + reference.getFile().getFullPathName());
+
+        juce::WavAudioFormat wav;
+        std::unique_ptr<juce::AudioFormatWriter> writer (wav.createWriterFor(stream.get(), settings.sampleRate, 2, 32, {}, 0));
+        if (writer == nullptr)
+            return fail("cannot write the one-job render");
+        stream.release();
+
+        std::cout << "Rendering again on one job to check the result" << std::endl;
+        if (renderInOrder(*writer, settings, numSamplesInFile) != 0)
+            return fail("writing to " + reference.getFile().getFullPathName() + " failed");
+        writer.reset();
+
+        juce::AudioFormatManager formats;
+        formats.registerBasicFormats();
+        std::unique_ptr<juce::AudioFormatReader> rendered (formats.createReaderFor(outputFile));
+        std::unique_ptr<juce::AudioFormatReader> expected (formats.createReaderFor(reference.getFile()));
+        if (rendered == nullptr || expected == nullptr || rendered->lengthInSamples != expected->lengthInSamples)
+            return fail("cannot read the renders back to compare them");
+
+        // Read both files a block at a time, so the check runs in constant memory as well
+        juce::AudioBuffer<float> renderedBlock (2, settings.blockSize);
+        juce::AudioBuffer<float> expectedBlock (2, settings.blockSize);
+        float maxDifference = 0.0f;
+        juce::int64 maxDifferencePosition = 0;
+        for (juce::int64 position = 0; position < numSamplesInFile; position += settings.blockSize)
+        {
+            auto numSamples = (int) juce::jmin((juce::int64) settings.blockSize, numSamplesInFile - position);
+            rendered->read(&renderedBlock, 0, numSamples, position, true, true);
+            expected->read(&expectedBlock, 0, numSamples, position, true, true);
+
+            for (int channel = 0; channel < 2; ++channel)
+            {
+                auto* renderedSamples = renderedBlock.getReadPointer(channel);
+                auto* expectedSamples = expectedBlock.getReadPointer(channel);
+                for (int i = 0; i < numSamples; ++i)
+                {
+                    auto difference = std::abs(renderedSamples[i] - expectedSamples[i]);
+                    if (difference > maxDifference)
+                    {
+                        maxDifference = difference;
+                        maxDifferencePosition = position + i;
+                    }
+                }
+            }
+        }
+
+        auto maxDifferenceInFile = juce::Decibels::gainToDecibels(maxDifference, -200.0f);
+        std::cout << "Largest difference from the one-job render: " << maxDifferenceInFile << " dB, at "
+                  << (double) maxDifferencePosition / settings.sampleRate << " s" << std::endl;
+        if (maxDifferenceInFile > maxDifferenceDecibels)
+            return fail("the render differs from the one-job render by more than " + juce::String(maxDifferenceDecibels) + " dB");
+
+        return 0;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    // The processor's parameter tree starts timers, which need the message manager
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args (argc, argv);
+
+    if (args.size() == 0 || args.containsOption("--help|-h"))
+    {
+        printUsage();
+        return 0;
+    }
+
+    auto outputFile = args.arguments.getLast().resolveAsFile();
+    if (args.containsOption("--convert-score"))
+        return convertScore(args.getFileForOption("--convert-score"), outputFile);
+
+    auto lengthSeconds = getOption(args, "--length|-l", "600").getDoubleValue();
+    auto bitDepth = getOption(args, "--bits", "24").getIntValue();
+    auto numJobs = getOption(args, "--jobs", "1").getIntValue();
+
+    RenderSettings settings;
+    settings.sampleRate = getOption(args, "--sample-rate|-r", "48000").getDoubleValue();
+    settings.blockSize = getOption(args, "--block-size|-b", "512").getIntValue();
+    settings.numWorkers = getOption(args, "--workers", "0").getIntValue();
+    settings.pipelinedReverb = args.containsOption("--pipelined-reverb");
+    settings.fixedPointPhase = args.containsOption("--fixed-point-phase");
+    settings.hasSeed = args.containsOption("--seed");
+    if (settings.hasSeed)
+        settings.seed = (juce::uint64) args.getValueForOption("--seed").getLargeIntValue();
+
+    if (lengthSeconds <= 0.0 || settings.sampleRate <= 0.0 || settings.blockSize <= 0 || numJobs <= 0)
+        return fail("length, sample rate, block size and jobs must be positive");
+
+    auto isCheckingJobs = args.containsOption("--check-jobs");
+    auto maxDifferenceDecibels = getOption(args, "--check-jobs", "0").getDoubleValue();
+    if (isCheckingJobs && numJobs < 2)
+        return fail("--check-jobs compares a render on several jobs, so it needs --jobs 2 or more");
+
+    // Check the patch once here, rather than in every processor
+    if (args.containsOption("--patch"))
+    {
+        auto patchFile = args.getFileForOption("--patch");
+        if (! patchFile.existsAsFile())
+            return fail("cannot read " + patchFile.getFullPathName());
+
+        settings.patch = patchFile.loadFileAsString();
+        ModulationEngine::Schedule schedule;
+        auto result = ModulationPatch::compile(settings.patch, schedule);
+        if (result.failed())
+            return fail(patchFile.getFullPathName() + ": " + result.getErrorMessage());
+    }
+
+    if (args.containsOption("--score"))
+    {
+        settings.score = args.getFileForOption("--score");
+        Score score;
+        auto result = score.load(settings.score);
+        if (result.failed())
+            return fail(settings.score.getFullPathName() + ": " + result.getErrorMessage());
+    }
+
+    auto format = createFormatFor(outputFile);
+    if (format == nullptr)
+        return fail("the output file must end in .wav or .flac");
+
+    if (! format->getPossibleBitDepths().contains(bitDepth))
+        return fail(juce::String(bitDepth) + " bits is not supported by " + format->getFormatName());
+
+    // ============================== output file ==================================
+    // FileOutputStream appends, so start from an empty file
+    outputFile.deleteFile();
+    auto stream = std::make_unique<juce::FileOutputStream>(outputFile);
+    if (stream->failedToOpen())
+        return fail("cannot open " + outputFile.getFullPathName());
+
+    // The writer takes ownership of the stream only when it is created successfully.
+    // Long WAV renders are switched to RF64 by the writer once they pass 4 GB.
+    std::unique_ptr<juce::AudioFormatWriter> writer (format->createWriterFor(stream.get(), settings.sampleRate, 2,
+                                                                             bitDepth, {}, 0));
+    if (writer == nullptr)
+        return fail("cannot write " + format->getFormatName() + " at this sample rate and bit depth");
+    stream.release();
+
+    // ============================== render =======================================
+    auto numSamplesInFile = (juce::int64) std::llround(lengthSeconds * settings.sampleRate);
+
+    std::cout << "Rendering " << lengthSeconds << " s at " << settings.sampleRate << " Hz, "
+              << settings.blockSize << " samples per block";
+    if (numJobs > 1)
+        std::cout << ", " << numJobs << " segments at once";
+    std::cout << ", to " << outputFile.getFullPathName() << std::endl;
+
+    auto startTime = juce::Time::getMillisecondCounterHiRes();
+
+    auto result = numJobs > 1 ? renderInParallel(*writer, settings, numSamplesInFile, numJobs)
+                              : renderInOrder(*writer, settings, numSamplesInFile);
+    if (result != 0)
+        return fail("writing to " + outputFile.getFullPathName() + " failed");
+
+    writer.reset(); // flushes the stream and completes the header
+
+    auto elapsedSeconds = (juce::Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+    std::cout << "Rendered " << lengthSeconds << " s of audio in " << elapsedSeconds << " s, "
+              << "real-time factor " << lengthSeconds / juce::jmax(1.0e-9, elapsedSeconds) << "x" << std::endl;
+
+    if (isCheckingJobs)
+        return checkAgainstOneJob(outputFile, settings, numSamplesInFile, maxDifferenceDecibels);
+
+    return 0;
+}
@@ -0,0 +1,395 @@
+/*
+  ==============================================================================
+
+    FDNReverb.h
+    Created: 17 Oct 2026 9:26:40pm
+    Author:  70
+
+  ==============================================================================
+*/
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+/**
+    A stereo feedback-delay-network reverb with the same interface and parameters as juce::Reverb.
+
+    FDNReverb feeds eight delay lines back into each other through a Householder matrix (every line receives minus a quarter of the sum of all lines, plus itself), which spreads each echo over all lines without colouring it. Each line has a one-pole damping filter and a decay gain. The gains are chosen so every line reaches -60 dB in the same time, and that time is derived from roomSize the way Freeverb derives its comb feedback. The read taps are slowly modulated, each by its own quadrature oscillator, so the tail does not ring at fixed modes. Per-line state is kept in juce::dsp::SIMDRegister lanes, so filtering, decay and mixing take a handful of vector operations per sample. roomSize, damping, wetLevel, dryLevel, width and freezeMode mean the same as in juce::Reverb, so it can replace one directly. Initialize with setSampleRate(), set the sound with setParameters(), then call processStereo() or processMono().
+*/
+class FDNReverb
+{
+public:
+    using Parameters = juce::Reverb::Parameters;
+    using Register = juce::dsp::SIMDRegister<float>;
+
+    static constexpr int numLines = 8;
+
+    FDNReverb()
+    {
+        setSampleRate(44100.0);
+        setParameters(Parameters());
+    }
+
+    const Parameters& getParameters() const noexcept
+    {
+        return parameters;
+    }
+
+    // Applies new parameters, with the same ranges and meaning as juce::Reverb
+    void setParameters(const Parameters& newParams)
+    {
+        const float wetScaleFactor = 3.0f;
+        const float dryScaleFactor = 2.0f;
+
+        const float wet = newParams.wetLevel * wetScaleFactor;
+        dryGain.setTargetValue(newParams.dryLevel * dryScaleFactor);
+        wetGain1.setTargetValue(0.5f * wet * (1.0f + newParams.width));
+        wetGain2.setTargetValue(0.5f * wet * (1.0f - newParams.width));
+
+        gain = isFrozen(newParams.freezeMode) ? 0.0f : inputGain;
+        parameters = newParams;
+        updateDamping();
+    }
+
+    // Allocates the delay lines for a sample rate and clears the reverb. Not real-time safe.
+    void setSampleRate(double SR)
+    {
+        jassert(SR > 0);
+        sampleRate = SR;
+
+        // The lines share one write position, so they all get the size of the longest
+        auto bufferSize = (size_t) ((lineLengthsInSeconds[numLines - 1] + modulationDepth) * sampleRate) + 2;
+        for (int line = 0; line < numLines; ++line)
+        {
+            lineLength[line] = (float) (lineLengthsInSeconds[line] * sampleRate);
+            delayLines[line].assign(bufferSize, 0.0f);
+        }
+
+        for (int channel = 0; channel < 2; ++channel)
+            for (int stage = 0; stage < numDiffusers; ++stage)
+                diffusers[channel][stage].assign((size_t) (diffuserLengthsInSeconds[stage] * sampleRate) + channel * stereoSpread, 0.0f);
+
+        // Each line gets its own modulation rate, spread between 0.1 and 0.5 Hz
+        for (int line = 0; line < numLines; ++line)
+        {
+            auto rate = 0.1 + 0.4 * line / (numLines - 1);
+            auto angle = juce::MathConstants<double>::twoPi * rate / sampleRate;
+            rotationCos[line] = (float) std::cos(angle);
+            rotationSin[line] = (float) std::sin(angle);
+        }
+
+        const double smoothTime = 0.01;
+        dryGain.reset(sampleRate, smoothTime);
+        wetGain1.reset(sampleRate, smoothTime);
+        wetGain2.reset(sampleRate, smoothTime);
+
+        updateDamping();
+        reset();
+    }
+
+    // Clears the reverb's buffers
+    void reset()
+    {
+        for (auto& line : delayLines)
+            std::fill(line.begin(), line.end(), 0.0f);
+        for (auto& channel : diffusers)
+            for (auto& diffuser : channel)
+                std::fill(diffuser.begin(), diffuser.end(), 0.0f);
+
+        writePosition = 0;
+        diffuserPositions = {};
+
+        for (int line = 0; line < numLines; ++line)
+        {
+            dampingState[line] = 0.0f;
+            interpolatorState[line] = 0.0f;
+            decayGain[line] = targetDecayGain[line];
+        }
+        setModulationPosition(0);
+    }
+
+    // Turns the tap modulation to where it is numSamples after reset(), for a caller that skips ahead in its input
+    void setModulationPosition(juce::int64 numSamples)
+    {
+        const auto twoPi = juce::MathConstants<double>::twoPi;
+
+        for (int line = 0; line < numLines; ++line)
+        {
+            // The oscillators start spread around the circle and turn by the rotation set up in setSampleRate()
+            auto cyclesPerSample = std::atan2((double) rotationSin[line], (double) rotationCos[line]) / twoPi;
+            auto phase = twoPi * line / numLines + twoPi * std::fmod((double) numSamples * cyclesPerSample, 1.0);
+            modulationCos[line] = (float) std::cos(phase);
+            modulationSin[line] = (float) std::sin(phase);
+        }
+    }
+
+    // Turns the slow movement of the read taps on (the default) or off. Without it the taps stay where they are and are
+    // read without interpolation, which makes the reverb cheaper but lets the tail ring at fixed modes.
+    void setTapModulation(bool shouldModulate)
+    {
+        if (isModulated && ! shouldModulate)
+        {
+            const auto depth = (float) (0.5 * modulationDepth * sampleRate);
+            for (int line = 0; line < numLines; ++line)
+                fixedTaps[line] = depth * (1.0f + modulationSin[line]);
+        }
+        isModulated = shouldModulate;
+    }
+
+    bool isTapModulated() const noexcept
+    {
+        return isModulated;
+    }
+
+    // Time the tail takes to fall by 60 dB with these parameters, or infinity when frozen
+    static double getDecayTime(const Parameters& params)
+    {
+        const float roomScaleFactor = 0.28f;
+        const float roomOffset = 0.7f;
+
+        if (isFrozen(params.freezeMode))
+            return std::numeric_limits<double>::infinity();
+
+        // Freeverb's comb feedback for this roomSize, over its average comb length of 31 ms, gives the decay time
+        auto combFeedback = params.roomSize * roomScaleFactor + roomOffset;
+        return -3.0 * 0.031 / std::log10((double) combFeedback);
+    }
+
+    // Applies the reverb to two stereo channels of audio data
+    void processStereo(float* const left, float* const right, const int numSamples) noexcept
+    {
+        jassert(left != nullptr && right != nullptr);
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            auto input = (left[i] + right[i]) * gain;
+            float outL, outR;
+            processFrame(diffuse(0, input), diffuse(1, input), outL, outR);
+
+            const float dry = dryGain.getNextValue();
+            const float wet1 = wetGain1.getNextValue();
+            const float wet2 = wetGain2.getNextValue();
+
+            left[i]  = outL * wet1 + outR * wet2 + left[i]  * dry;
+            right[i] = outR * wet1 + outL * wet2 + right[i] * dry;
+        }
+
+        renormaliseModulation();
+    }
+
+    // Applies the reverb to a single mono channel of audio data
+    void processMono(float* const samples, const int numSamples) noexcept
+    {
+        jassert(samples != nullptr);
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            auto input = samples[i] * gain;
+            float outL, outR;
+            processFrame(diffuse(0, input), diffuse(1, input), outL, outR);
+
+            const float dry = dryGain.getNextValue();
+            const float wet1 = wetGain1.getNextValue();
+            samples[i] = 0.5f * (outL + outR) * wet1 + samples[i] * dry;
+        }
+
+        renormaliseModulation();
+    }
+
+private:
+    static constexpr int numLanes = (int) Register::SIMDNumElements;
+    static constexpr int numGroups = numLines / numLanes;
+    static_assert(numLines % numLanes == 0, "The lines must fill whole registers");
+
+    static constexpr int numDiffusers = 2;
+    static constexpr int stereoSpread = 23;           // extra samples in the right diffusers, as in Freeverb
+    static constexpr float inputGain = 0.015f;         // as in Freeverb
+    static constexpr float outputGain = 2.6f;          // brings the wet level in line with juce::Reverb's
+    static constexpr double modulationDepth = 0.0004;  // peak-to-peak tap movement in seconds
+
+    // Mutually prime-ish lengths between 30 and 62 ms, so the echoes of the lines do not line up
+    static constexpr double lineLengthsInSeconds[numLines] = { 0.0297, 0.0343, 0.0371, 0.0411, 0.0457, 0.0503, 0.0553, 0.0617 };
+    static constexpr double diffuserLengthsInSeconds[numDiffusers] = { 0.0051, 0.0077 };
+
+    Parameters parameters;
+    double sampleRate = 44100.0;
+    float gain = inputGain;
+
+    std::array<std::vector<float>, numLines> delayLines;
+    std::array<std::array<std::vector<float>, numDiffusers>, 2> diffusers;
+    std::array<std::array<int, numDiffusers>, 2> diffuserPositions {};
+    std::array<float, numLines> lineLength {};
+    int writePosition = 0;
+
+    static constexpr size_t alignment = Register::SIMDRegisterSize;
+
+    // Per-line state, one lane per line
+    alignas(alignment) float dampingState[numLines] {};
+    alignas(alignment) float decayGain[numLines] {};
+    alignas(alignment) float targetDecayGain[numLines] {};
+    alignas(alignment) float modulationCos[numLines] {};
+    alignas(alignment) float modulationSin[numLines] {};
+    alignas(alignment) float rotationCos[numLines] {};
+    alignas(alignment) float rotationSin[numLines] {};
+    alignas(alignment) float taps[numLines] {};
+    alignas(alignment) float feedback[numLines] {};
+    float interpolatorState[numLines] {};
+    float fixedTaps[numLines] {};   // tap offsets while the modulation is off
+    bool isModulated = true;
+
+    float damping = 0.0f;   // one-pole coefficient of the damping filters
+    juce::SmoothedValue<float> dryGain, wetGain1, wetGain2;
+
+    static bool isFrozen(float freezeMode) noexcept
+    {
+        return freezeMode >= 0.5f;
+    }
+
+    // Derives the damping and the per-line decay gains from roomSize, damping and freezeMode
+    void updateDamping()
+    {
+        const float dampScaleFactor = 0.4f;
+
+        if (isFrozen(parameters.freezeMode))
+        {
+            damping = 0.0f;
+            for (auto& g : targetDecayGain)
+                g = 1.0f;
+            return;
+        }
+
+        damping = parameters.damping * dampScaleFactor;
+        auto decaySeconds = getDecayTime(parameters);
+
+        for (int line = 0; line < numLines; ++line)
+            targetDecayGain[line] = (float) std::pow(10.0, -3.0 * lineLengthsInSeconds[line] / decaySeconds);
+    }
+
+    // Schroeder allpass diffusion of the input, as in Freeverb's allpass stages
+    float diffuse(int channel, float input) noexcept
+    {
+        for (int stage = 0; stage < numDiffusers; ++stage)
+        {
+            auto& buffer = diffusers[(size_t) channel][(size_t) stage];
+            auto& position = diffuserPositions[(size_t) channel][(size_t) stage];
+            const float bufferedValue = buffer[(size_t) position];
+            buffer[(size_t) position] = input + bufferedValue * 0.5f;
+            if (++position >= (int) buffer.size())
+                position = 0;
+            input = bufferedValue - input;
+        }
+        return input;
+    }
+
+    // Runs one sample through the network and returns the left and right wet outputs
+    void processFrame(float inputL, float inputR, float& outL, float& outR) noexcept
+    {
+        const auto depth = (float) (0.5 * modulationDepth * sampleRate);
+
+        // Modulated, linearly interpolated reads from every line, or fixed taps while the modulation is off
+        if (isModulated)
+        {
+            for (int group = 0; group < numGroups; ++group)
+            {
+                auto offset = group * numLanes;
+                auto c = Register::fromRawArray(modulationCos + offset);
+                auto s = Register::fromRawArray(modulationSin + offset);
+                auto rc = Register::fromRawArray(rotationCos + offset);
+                auto rs = Register::fromRawArray(rotationSin + offset);
+                (c * rc - s * rs).copyToRawArray(modulationCos + offset);
+                (s * rc + c * rs).copyToRawArray(modulationSin + offset);
+                (Register::expand(depth) * (Register::expand(1.0f) + s)).copyToRawArray(taps + offset);
+            }
+        }
+        else
+        {
+            std::copy(fixedTaps, fixedTaps + numLines, taps);
+        }
+
+        // First-order allpass interpolation keeps the loop lossless as the taps move, where linear interpolation would damp it.
+        // The read starts half a sample early so the fractional delay stays between 0.5 and 1.5, where the allpass is best behaved.
+        for (int line = 0; line < numLines; ++line)
+        {
+            auto& buffer = delayLines[(size_t) line];
+            auto size = (int) buffer.size();
+            auto readPosition = (float) writePosition - lineLength[(size_t) line] + taps[line] + 0.5f;
+            if (readPosition < 0.0f)
+                readPosition += (float) size;
+            auto index = juce::jmin((int) readPosition, size - 1);
+            if (! isModulated)
+            {
+                // Fixed taps are read straight from the line; the interpolator follows, so it can resume without a jump
+                taps[line] = interpolatorState[line] = buffer[(size_t) index];
+                continue;
+            }
+
+            auto fraction = 1.5f - (readPosition - (float) index);
+            auto newer = index + 1 < size ? index + 1 : 0;
+            auto eta = (1.0f - fraction) / (1.0f + fraction);
+            interpolatorState[line] = eta * (buffer[(size_t) newer] - interpolatorState[line]) + buffer[(size_t) index];
+            taps[line] = interpolatorState[line];
+        }
+
+        // Damping, decay and the Householder matrix: feedback = y - (2 / N) * sum(y)
+        const auto dampingCoefficient = Register::expand(damping);
+        const auto oneMinusDamping = Register::expand(1.0f - damping);
+        const auto gainSmoothing = Register::expand(0.001f);
+
+        Register filtered[numGroups];
+        float sum = 0.0f;
+        for (int group = 0; group < numGroups; ++group)
+        {
+            auto offset = group * numLanes;
+            auto state = Register::fromRawArray(dampingState + offset);
+            state = Register::fromRawArray(taps + offset) * oneMinusDamping + state * dampingCoefficient;
+            state.copyToRawArray(dampingState + offset);
+
+            auto g = Register::fromRawArray(decayGain + offset);
+            g = g + (Register::fromRawArray(targetDecayGain + offset) - g) * gainSmoothing;
+            g.copyToRawArray(decayGain + offset);
+
+            filtered[group] = state * g;
+            sum += filtered[group].sum();
+        }
+
+        auto reflection = Register::expand(sum * (2.0f / numLines));
+        for (int group = 0; group < numGroups; ++group)
+            (filtered[group] - reflection).copyToRawArray(feedback + group * numLanes);
+
+        // The left input feeds the first half of the lines and the right input the second half
+        for (int line = 0; line < numLines; ++line)
+            feedback[line] += line < numLines / 2 ? inputL : inputR;
+
+        for (int line = 0; line < numLines; ++line)
+            delayLines[(size_t) line][(size_t) writePosition] = feedback[line];
+
+        if (++writePosition >= (int) delayLines[0].size())
+            writePosition = 0;
+
+        // Two orthogonal sign patterns over all lines give decorrelated left and right outputs
+        outL = 0.0f;
+        outR = 0.0f;
+        for (int line = 0; line < numLines; ++line)
+        {
+            outL += (line & 1) == 0 ? taps[line] : -taps[line];
+            outR += (line & 2) == 0 ? taps[line] : -taps[line];
+        }
+        outL *= outputGain;
+        outR *= outputGain;
+    }
+
+    // Keeps the modulation oscillators on the unit circle despite rounding
+    void renormaliseModulation() noexcept
+    {
+        for (int line = 0; line < numLines; ++line)
+        {
+            auto magnitude = std::sqrt(modulationCos[line] * modulationCos[line] + modulationSin[line] * modulationSin[line]);
+            modulationCos[line] /= magnitude;
+            modulationSin[line] /= magnitude;
+        }
+    }
+};
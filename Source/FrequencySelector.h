@@ -10,7 +10,11 @@
 #pragma once
 
 #include <JuceHeader.h>
-#include <vector>
+#include <array>
+#include <initializer_list>
+#include <type_traits>
+#include "Pcg32.h"
+#include "Score.h"
 
 /**
     Manages dynamic frequency selection from a predefined list for audio applications.
@@ -19,7 +23,10 @@
     creating varied audio outputs in applications such as synthesizers and audio testing tools. Configure
     it by setting a sample rate, a list of frequencies, a hold duration for each frequency, and the selection
     mode. Use process() to retrieve the current frequency based on the configured parameters and selection
-    logic.
+    logic, or render whole notes at a time: getCurrentFrequency() stays valid for getNumSamplesToNextChange()
+    samples, after which advance() moves on to the next note. Given a layer of a Score, the selector plays its
+    events in a loop instead, moving a cursor through the mapped file, and only takes the hold duration and the
+    sample rate from the parameters.
  */
 class FrequencySelector
 {
@@ -32,14 +39,29 @@ public:
         Sequential // Frequencies are chosen in the order they appear in the list
     };
 
-    // Holds configuration parameters for the FrequencySelector
+    // The largest number of frequencies a sequence can hold
+    static constexpr int maxFrequencies = 32;
+
+    // Holds configuration parameters for the FrequencySelector.
+    // The frequency list has a fixed capacity, so Parameters can be copied without allocating.
     struct Parameters 
     {
-        float sampleRate = 44100.0f;                 // The audio sample rate in Hz, defaulting to 44.1kHz.
-        std::vector<float> frequencies = {440.0f};   // A list of frequencies to select from, defaulting to A4.
-        float holdDuration = 1.0f;                   // The duration to hold a selected frequency in seconds.
-        SelectionMode mode = SelectionMode::Random;  // The mode of frequency selection, defaulting to random.
+        float sampleRate = 44100.0f;                                // The audio sample rate in Hz, defaulting to 44.1kHz.
+        std::array<float, maxFrequencies> frequencies = {440.0f};   // A list of frequencies to select from, defaulting to A4.
+        int numFrequencies = 1;                                     // The number of entries of frequencies in use.
+        float holdDuration = 1.0f;                                  // The duration to hold a selected frequency in seconds.
+        SelectionMode mode = SelectionMode::Random;                 // The mode of frequency selection, defaulting to random.
+
+        // Replaces the frequency list. Entries beyond maxFrequencies are ignored.
+        void setFrequencies(std::initializer_list<float> newFrequencies)
+        {
+            numFrequencies = 0;
+            for (auto frequency : newFrequencies)
+                if (numFrequencies < maxFrequencies)
+                    frequencies[numFrequencies++] = frequency;
+        }
     };
+    static_assert(std::is_trivially_copyable<Parameters>::value, "Parameters must be copyable without allocating");
 
     // Constructor that initializes the FrequencySelector with default parameters
     FrequencySelector()
@@ -49,53 +71,132 @@ public:
 
     // Returns a constant reference to the current parameters.
     const Parameters& getParameters() const noexcept { return parameters; }
+    
+    // Restarts the selector's own random generator. The same seed and stream, followed by the same
+    // parameters, always select the same frequencies. Call before setParameters().
+    void setSeed(juce::uint64 seed, juce::uint64 stream = 0) { random.setSeed(seed, stream); }
+    
+    // Plays the events of a score layer instead of the frequency list, or the list again if the layer is empty.
+    // The score must stay loaded while the selector uses it. Call before setParameters(), which starts the layer.
+    void setScoreLayer(const Score::Layer& newLayer) { scoreLayer = newLayer; }
+    
+    // Moves to another score layer while playing, or back to the frequency list if the layer is empty. The current
+    // frequency is held to its end, and the next one is the first event of the new layer; the old layer is not read again.
+    void changeScoreLayer(const Score::Layer& newLayer)
+    {
+        scoreLayer = newLayer;
+        eventIndex = 0;
+    }
 
     // Sets the parameters for frequency selection and updates the internal state accordingly.
+    // A count of frequencies beyond the list is clamped to it.
     void setParameters(const Parameters& newParams) 
     {
+        jassert(newParams.numFrequencies >= 0 && newParams.numFrequencies <= maxFrequencies);
         parameters = newParams;
-        samplesUntilNextFrequency = int(parameters.sampleRate * parameters.holdDuration);
+        parameters.numFrequencies = juce::jlimit(0, maxFrequencies, parameters.numFrequencies);
+        
         sequenceIndex = 0; // Reset sequence index on parameter change
+        eventIndex = 0;
         updateFrequency(); // Update frequency with new parameters
+        
+        // The first frequency is held one sample less than the rest
+        samplesToNextChange = samplesPerFrequency - 1;
+        if (samplesToNextChange <= 0)
+        {
+            updateFrequency();
+            samplesToNextChange = samplesPerFrequency;
+        }
+    }
+
+    // Changes how long each frequency is held without restarting the selection. The current frequency keeps the time it
+    // has been held so far, and moves on with the next sample if that is already longer than the new duration.
+    void setHoldDuration(float seconds)
+    {
+        auto samplesHeld = samplesPerFrequency - samplesToNextChange;
+        parameters.holdDuration = seconds;
+        samplesPerFrequency = getNumSamplesToHold(currentHolds);
+        samplesToNextChange = juce::jmax(1, samplesPerFrequency - samplesHeld);
     }
 
     // Processes a single sample, updating the frequency selection as necessary
     float process()
     {
-        if (++samplesPlayed >= samplesUntilNextFrequency)
+        auto frequency = currentFrequency;
+        advance(1);
+        return frequency;
+    }
+    
+    // The frequency of the next sample
+    float getCurrentFrequency() const noexcept { return currentFrequency; }
+    
+    // How many samples, starting with the next one, keep the current frequency (at least 1)
+    int getNumSamplesToNextChange() const noexcept { return samplesToNextChange; }
+    
+    // Moves on by numSamples, which must not go past the next change, and selects the next frequency when it is reached
+    void advance(int numSamples)
+    {
+        jassert(numSamples <= samplesToNextChange);
+        samplesToNextChange -= numSamples;
+        if (samplesToNextChange <= 0)
+        {
             updateFrequency();
-        return currentFrequency;
+            samplesToNextChange = samplesPerFrequency;
+        }
     }
 
 private:
     Parameters parameters;                 // Holds the current selection parameters.
-    int samplesUntilNextFrequency = 0;     // The number of samples to play before selecting a new frequency.
-    int samplesPlayed = 0;                 // The number of samples that have been played since the last update.
+    int samplesPerFrequency = 1;           // The number of samples the current frequency is held for.
+    float currentHolds = 1.0f;             // How many hold durations the current frequency lasts.
+    int samplesToNextChange = 1;           // The number of samples left before selecting a new frequency.
     float currentFrequency = 440.0f;       // The current frequency being output.
     unsigned int sequenceIndex = 0;        // The index for the next frequency in sequential mode.
+    Pcg32 random;                          // The generator for random mode, owned by this selector.
+    Score::Layer scoreLayer;               // The score layer to play, if it has any events.
+    int eventIndex = 0;                    // The cursor: the index of the next event of the score layer.
+    
+    // Samples that a number of hold durations last. Rounded, so durations a hair off a whole number of samples, as
+    // host parameters often are, still land on it.
+    int getNumSamplesToHold(float holds) const
+    {
+        return juce::jmax(1, juce::roundToInt(parameters.sampleRate * parameters.holdDuration * holds));
+    }
 
     // Updates the current frequency based on the selection mode and parameters.
     void updateFrequency()
     {
-        if (parameters.frequencies.empty()) return;
+        // A score layer: the next event, choosing at random between its frequencies if it has several
+        if (scoreLayer.numEvents > 0)
+        {
+            auto& event = scoreLayer.events[eventIndex];
+            auto choice = event.numFrequencies > 1 ? random.nextInt((int) event.numFrequencies) : 0;
+            currentFrequency = scoreLayer.frequencies[event.firstFrequency + (juce::uint32) choice];
+            currentHolds = event.holds;
+            samplesPerFrequency = getNumSamplesToHold(currentHolds);
+            if (++eventIndex >= scoreLayer.numEvents) eventIndex = 0; // Loop back to the start
+            return;
+        }
+        
+        currentHolds = 1.0f;
+        samplesPerFrequency = getNumSamplesToHold(currentHolds);
+        if (parameters.numFrequencies <= 0) return;
 
         switch (parameters.mode) 
         {
             case SelectionMode::Random: 
             {
-                auto randomIndex = juce::Random::getSystemRandom().nextInt(int(parameters.frequencies.size()));
+                auto randomIndex = random.nextInt(parameters.numFrequencies);
                 currentFrequency = parameters.frequencies[randomIndex]; // Select a random frequency
                 break;
             }
             case SelectionMode::Sequential: 
             {
                 currentFrequency = parameters.frequencies[sequenceIndex++]; // Select the next frequency in sequence
-                if (sequenceIndex >= parameters.frequencies.size()) sequenceIndex = 0; // Loop back to the start
+                if (sequenceIndex >= (unsigned int) parameters.numFrequencies) sequenceIndex = 0; // Loop back to the start
                 break;
             }
         }
-
-        samplesPlayed = 0;
     }
 };
 
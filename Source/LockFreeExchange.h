@@ -0,0 +1,56 @@
+/*
+  ==============================================================================
+
+    LockFreeExchange.h
+    Created: 17 Oct 2026 4:12:26pm
+    Author:  70
+
+  ==============================================================================
+*/
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <type_traits>
+
+/**
+    Hands values from one writer thread to one reader thread without locks or allocation.
+
+    LockFreeExchange is a triple buffer: the writer fills its own slot and swaps it into the shared middle slot, the reader swaps the middle slot with its own when something new has been published. Neither side ever waits for the other, and the reader always gets the most recent complete value. Use push() on the writer thread (e.g. the message thread) and pull() on the reader thread (e.g. the audio thread).
+*/
+template <typename ValueType>
+class LockFreeExchange
+{
+public:
+    static_assert(std::is_trivially_copyable<ValueType>::value, "Values are copied between threads, so they must be trivially copyable");
+
+    // Publishes a new value. Call from the writer thread only.
+    void push(const ValueType& newValue)
+    {
+        slots[writeIndex] = newValue;
+        auto previous = middle.exchange(writeIndex | newDataFlag, std::memory_order_acq_rel);
+        writeIndex = previous & indexMask;
+    }
+
+    // Copies the newest value into destination if one was published since the last call.
+    // Returns false, leaving destination untouched, when there is nothing new. Call from the reader thread only.
+    bool pull(ValueType& destination)
+    {
+        if ((middle.load(std::memory_order_acquire) & newDataFlag) == 0)
+            return false;
+
+        auto previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+        readIndex = previous & indexMask;
+        destination = slots[readIndex];
+        return true;
+    }
+
+private:
+    static constexpr int indexMask = 3;
+    static constexpr int newDataFlag = 4;
+
+    ValueType slots[3] {};
+    std::atomic<int> middle { 1 };  // slot index shared by both sides, plus the new data flag
+    int writeIndex = 0;             // owned by the writer
+    int readIndex = 2;              // owned by the reader
+};
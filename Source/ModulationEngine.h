@@ -0,0 +1,450 @@
+/*
+  ==============================================================================
+
+    ModulationEngine.h
+    Created: 17 Oct 2026 10:04:12am
+    Author:  70
+
+  ==============================================================================
+*/
+#pragma once
+
+#include "Oscillators.h"
+#include "PadSynth.h"
+#include "Movement.h"
+#include <JuceHeader.h>
+#include <array>
+
+/**
+    Evaluates the slow modulation sources at a control rate and hands out smoothed parameter values.
+
+    Which sources there are and where they are routed is set by a Schedule, which ModulationPatch compiles from a patch file; the patch the piece was composed with has the LFOs lfo, lfo2 and volLfo and the Movement amplitude control. Instead of advancing them every sample, the sources are evaluated once per control interval (e.g. every 32 or 64 samples), each exactly once however many routes read it, and every target is linearly ramped towards its new value over the following interval, so per-sample consumers stay click-free. Initialize with setSchedule() and prepare(), then in the audio loop call updateIfDue() at the start of each span, render at most getNumSamplesToNextUpdate() samples and report them with advance().
+*/
+class ModulationEngine
+{
+public:
+    // Parameters driven by the modulation sources, with the ranges the default patch sweeps them over
+    enum Target
+    {
+        movementLevel,           // Bounce and subbass amplitude, 0~0.5
+        leftVolume,              // Embellishment panning, 0~1 (right = 1 - left)
+        padCutoff,               // Pad chords low-pass cutoff, -1~1 across padCutoffMin~padCutoffMax
+        padLFOFrequency,         // Pad chords phase modulation rate, 0.1~6.1 Hz
+        padLFOAmount,            // Pad chords phase modulation depth, 0~0.25
+        bounceCutoff,            // Bounce high-pass cutoff, -1~1 across bounceCutoffMin~bounceCutoffMax
+        bounceLFOFrequency,      // Bounce phase modulation rate, 0.1~5.1 Hz
+        stringRootVolume,        // Root note string level, 0~0.67
+        stringRootSawAmount,     // Root note string saw amount, 0~1
+        stringOctaveUpSawAmount, // Octave-up string saw amount, 0.5~1
+        subPulseWidth,           // Subbass pulse width, 0~0.5
+        subSquareAmount,         // Subbass square amount, 0.25~0.75
+        subDetuneFine,           // Subbass fine detune, -30~30 cents
+        numTargets
+    };
+
+    // Rates of the modulation sources, and the ranges the filter cutoffs are swept over
+    struct Settings
+    {
+        float lfoRate = 0.4f;               // lfo: cutoffs, pad LFO, saw amounts, subbass square and detune, in Hz
+        float lfo2Rate = 0.4f;              // lfo2: bounce LFO rate, root string level, subbass pulse width, in Hz
+        float panRate = 1.0f;               // volLfo: embellishment panning, in Hz
+        float movementRate = 5.0f;          // movement: bounce and subbass amplitude, in Hz
+        float padCutoffMin = 1000.0f;       // in Hz
+        float padCutoffMax = 9000.0f;
+        float bounceCutoffMin = 1000.0f;
+        float bounceCutoffMax = 3000.0f;
+    };
+
+    // Kinds of modulation source
+    enum class SourceType
+    {
+        sine,       // SinOsc, -1~1
+        pad,        // PadSynth: a sine, phase modulated by its own LFO and low-pass filtered, about -1~1
+        movement    // Movement: a sine with vibrato, clipped to 0~0.5
+    };
+
+    static constexpr int maxSources = 8;
+    static constexpr int maxSteps = 64;
+
+    // The highest rate a source can run at, in Hz: below the control Nyquist at 44.1 kHz with the coarse control
+    // interval of 64 samples, the lowest control rate the plugin drops to
+    static constexpr float maxSourceRate = 300.0f;
+
+    // A modulation source and how it is set up
+    struct Source
+    {
+        SourceType type = SourceType::sine;
+        float Settings::* rateSetting = nullptr;    // the rate in Settings it runs at, or nullptr to run at rate
+        float rate = 1.0f;                          // in Hz
+        float innerRate = 0.0f;                     // pad: rate of its phase modulation; movement: rate of its vibrato, in Hz
+        float cutoff = 5000.0f;                     // pad: low-pass cutoff in Hz, kept below the control Nyquist
+        float amount = 0.0f;                        // pad: phase modulation amount; movement: vibrato amount
+    };
+
+    // One step of a schedule: evaluates a source, or adds a route's value to the amount of a source or to a target
+    struct Step
+    {
+        enum Kind
+        {
+            evaluate,
+            routeToAmount,
+            routeToTarget
+        };
+
+        Kind kind = evaluate;
+        int source = 0;         // the source evaluated, or the one the route reads
+        int destination = 0;    // the source or the Target the route feeds
+        float scale = 1.0f;     // a route adds source * scale + offset
+        float offset = 0.0f;
+    };
+
+    // The sources in the order they are evaluated, and the steps that run once per control interval. A source comes
+    // after every source routed into its amount, so each is evaluated once and its value is shared by all its routes.
+    // Targets that no route feeds stay at 0. Holds no pointers to the heap, so it can be handed between threads.
+    struct Schedule
+    {
+        std::array<Source, maxSources> sources {};
+        int numSources = 0;
+        std::array<Step, maxSteps> steps {};
+        int numSteps = 0;
+    };
+
+    // Name of a target, as patches refer to it
+    static const char* getTargetName(Target target)
+    {
+        switch (target)
+        {
+            case movementLevel:            return "movementLevel";
+            case leftVolume:               return "leftVolume";
+            case padCutoff:                return "padCutoff";
+            case padLFOFrequency:          return "padLFOFrequency";
+            case padLFOAmount:             return "padLFOAmount";
+            case bounceCutoff:             return "bounceCutoff";
+            case bounceLFOFrequency:       return "bounceLFOFrequency";
+            case stringRootVolume:         return "stringRootVolume";
+            case stringRootSawAmount:      return "stringRootSawAmount";
+            case stringOctaveUpSawAmount:  return "stringOctaveUpSawAmount";
+            case subPulseWidth:            return "subPulseWidth";
+            case subSquareAmount:          return "subSquareAmount";
+            case subDetuneFine:            return "subDetuneFine";
+            default:                       return "";
+        }
+    }
+
+    // Replaces the sources and the routes. The new sources start from the beginning of their cycles and the targets
+    // move to their new values over the next control interval. Allocates nothing, so the audio thread can call it.
+    void setSchedule(const Schedule& newSchedule)
+    {
+        schedule = newSchedule;
+        resetSources();
+        setControlInterval(controlInterval);
+    }
+
+    // Sets the host sample rate and control interval, and resets all sources
+    void prepare(float SR, int interval)
+    {
+        sampleRate = SR;
+        isFirstUpdate = true;
+        setControlInterval(interval);
+        resetSources();
+    }
+
+    // Keeps the phases of all LFOs in fixed point, so they do not drift over long runs
+    void setFixedPointPhase(bool shouldUseFixedPoint)
+    {
+        for (int i = 0; i < maxSources; i++)
+        {
+            sines[i].setFixedPointPhase(shouldUseFixedPoint);
+            pads[i].setFixedPointPhase(shouldUseFixedPoint);
+            movements[i].setFixedPointPhase(shouldUseFixedPoint);
+        }
+    }
+
+    // Changes the rates and ranges. The sources keep their phases, and the cutoff targets move into new ranges at once.
+    void setSettings(const Settings& newSettings)
+    {
+        settings = newSettings;
+        updateRates();
+
+        if (! isFirstUpdate)
+        {
+            setTarget(padCutoff, padCutoffPosition * padCutoffDepth + padCutoffCentre);
+            setTarget(bounceCutoff, bounceCutoffPosition * bounceCutoffDepth + bounceCutoffCentre);
+        }
+    }
+
+    const Settings& getSettings() const noexcept { return settings; }
+
+    // Sets how many samples pass between two evaluations of the modulation sources
+    void setControlInterval(int interval)
+    {
+        controlInterval = juce::jmax(1, interval);
+        auto controlRate = sampleRate / controlInterval;
+
+        // The sources run at the control rate, so one process() call advances them by a whole interval.
+        // lfo and lfo2 used to be read several times per sample, which made them run at a multiple of
+        // their nominal rate (0.05 Hz and 0.1 Hz); the default rates in Settings are the ones that were actually heard.
+        for (int i = 0; i < schedule.numSources; i++)
+        {
+            auto& source = schedule.sources[i];
+            switch (source.type)
+            {
+                case SourceType::pad:
+                    pads[i].setFilterCutOff(juce::jmin(source.cutoff, controlRate * 0.4f)); // keep the filter below the control Nyquist
+                    pads[i].setSampleRate(controlRate);
+                    pads[i].setLFOFrequency(source.innerRate);
+                    break;
+                case SourceType::movement:
+                    movements[i].setSampleRate(controlRate);
+                    movements[i].setVibratoFreq(source.innerRate);
+                    break;
+                case SourceType::sine:
+                default:
+                    sines[i].setSampleRate(controlRate);
+                    break;
+            }
+        }
+        updateRates();
+
+        for (auto& ramp : ramps)
+            ramp.reset(controlInterval);
+
+        samplesToNextUpdate = 0;
+    }
+
+    int getControlInterval() const noexcept { return controlInterval; }
+
+    // Returns the number of samples that can be rendered before the sources must be evaluated again
+    int getNumSamplesToNextUpdate() const noexcept { return samplesToNextUpdate; }
+
+    // Evaluates the modulation sources if a control interval has elapsed.
+    // Returns true when new targets were set, so control-rate consumers should be updated.
+    bool updateIfDue()
+    {
+        if (samplesToNextUpdate > 0)
+            return false;
+
+        // Each source is evaluated after the routes into its amount, and all routes from it read the same value
+        std::array<float, maxSources> values {};
+        std::array<float, maxSources> amounts {};
+        std::array<float, numTargets> targetValues {};
+        for (int i = 0; i < schedule.numSources; i++)
+            amounts[i] = schedule.sources[i].amount;
+
+        for (int i = 0; i < schedule.numSteps; i++)
+        {
+            auto& step = schedule.steps[i];
+            switch (step.kind)
+            {
+                case Step::evaluate:
+                    values[step.source] = evaluateSource(step.source, amounts[step.source]);
+                    break;
+                case Step::routeToAmount:
+                    amounts[step.destination] += values[step.source] * step.scale + step.offset;
+                    break;
+                case Step::routeToTarget:
+                    targetValues[step.destination] += values[step.source] * step.scale + step.offset;
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        // The cutoffs sweep the ranges in the settings
+        padCutoffPosition = targetValues[padCutoff];
+        bounceCutoffPosition = targetValues[bounceCutoff];
+        targetValues[padCutoff] = padCutoffPosition * padCutoffDepth + padCutoffCentre;
+        targetValues[bounceCutoff] = bounceCutoffPosition * bounceCutoffDepth + bounceCutoffCentre;
+
+        for (int target = 0; target < numTargets; target++)
+            setTarget(Target (target), targetValues[target]);
+
+        lastValues = values;
+        isFirstUpdate = false;
+        samplesToNextUpdate = controlInterval;
+        return true;
+    }
+
+    // Marks numSamples as rendered. Must not exceed getNumSamplesToNextUpdate().
+    void advance(int numSamples)
+    {
+        jassert(numSamples <= samplesToNextUpdate);
+        samplesToNextUpdate -= numSamples;
+    }
+
+    // Marks numSamples as skipped: like advance(), but also moves the ramps on as if their values had been read.
+    // Must not exceed getNumSamplesToNextUpdate().
+    void skip(int numSamples)
+    {
+        for (auto& ramp : ramps)
+            ramp.skip(numSamples);
+        advance(numSamples);
+    }
+
+    // Moves on by numSamples without evaluating the sources at every update they hold, for skipping a long stretch.
+    // The sources move over all updates but the last in closed form, pad and movement sources at the amounts routed
+    // into them at the update before the stretch; the last update is evaluated as usual, and the ramps end at the
+    // targets it sets. Fills averages with the mean of each target over the updates, so voices whose rates follow a
+    // target can be moved over the stretch in closed form too. The means are exact for sine sources, close for pad
+    // sources, and take movement sources as holding their value until the last update.
+    void skipUpdates(int numSamples, std::array<float, numTargets>& averages)
+    {
+        for (int target = 0; target < numTargets; target++)
+            averages[target] = ramps[target].getTargetValue();
+
+        if (numSamples <= samplesToNextUpdate)
+        {
+            skip(numSamples);
+            return;
+        }
+
+        // The updates fall samplesToNextUpdate samples in and then once every control interval
+        auto samplesBeforeFirstUpdate = samplesToNextUpdate;
+        auto numUpdates = (numSamples - 1 - samplesBeforeFirstUpdate) / controlInterval + 1;
+        auto samplesAfterLastUpdate = numSamples - samplesBeforeFirstUpdate - (numUpdates - 1) * controlInterval;
+
+        std::array<double, maxSources> sums {};
+        for (int i = 0; i < schedule.numSources; i++)
+        {
+            switch (schedule.sources[i].type)
+            {
+                case SourceType::pad:
+                    sums[i] = pads[i].sumOfNextSamples(numUpdates - 1);
+                    pads[i].skip(numUpdates - 1);
+                    break;
+                case SourceType::movement:
+                    sums[i] = (double) lastValues[i] * (numUpdates - 1);
+                    movements[i].skip(numUpdates - 1);
+                    break;
+                case SourceType::sine:
+                default:
+                    sums[i] = sines[i].sumOfNextSamples(numUpdates - 1);
+                    sines[i].skip(numUpdates - 1);
+                    break;
+            }
+        }
+
+        samplesToNextUpdate = 0;
+        updateIfDue();
+        for (auto& ramp : ramps)
+            ramp.setCurrentAndTargetValue(ramp.getTargetValue());
+        samplesToNextUpdate = controlInterval - samplesAfterLastUpdate;
+
+        // Each target holds its old value until the first update and then each new one for the samples up to the next.
+        // A route adds the same linear function of its source at every update, so it sums up from the source's sums.
+        auto samplesFromFirstUpdate = (double) (numSamples - samplesBeforeFirstUpdate);
+        std::array<double, numTargets> sumsFromFirstUpdate {};
+        for (int i = 0; i < schedule.numSteps; i++)
+        {
+            auto& step = schedule.steps[i];
+            if (step.kind == Step::routeToTarget)
+            {
+                auto sourceSum = sums[step.source] * controlInterval + (double) lastValues[step.source] * samplesAfterLastUpdate;
+                sumsFromFirstUpdate[step.destination] += sourceSum * step.scale + step.offset * samplesFromFirstUpdate;
+            }
+        }
+        sumsFromFirstUpdate[padCutoff] = sumsFromFirstUpdate[padCutoff] * padCutoffDepth + padCutoffCentre * samplesFromFirstUpdate;
+        sumsFromFirstUpdate[bounceCutoff] = sumsFromFirstUpdate[bounceCutoff] * bounceCutoffDepth + bounceCutoffCentre * samplesFromFirstUpdate;
+
+        for (int target = 0; target < numTargets; target++)
+            averages[target] = (float) ((averages[target] * (double) samplesBeforeFirstUpdate + sumsFromFirstUpdate[target]) / numSamples);
+    }
+
+    // Moves one ramped target on by numSamples, as if its values had been read, for a voice that skips rendering
+    void skipValues(Target target, int numSamples)
+    {
+        ramps[target].skip(numSamples);
+    }
+
+    // Returns the next per-sample value of a ramped target. Call once per rendered sample.
+    float getNextValue(Target target)
+    {
+        return ramps[target].getNextValue();
+    }
+
+    // Returns the value a target is ramping towards. Use for parameters applied once per control interval.
+    float getTargetValue(Target target) const
+    {
+        return ramps[target].getTargetValue();
+    }
+
+private:
+    // One slot of each kind per source; a source uses the slot of its type
+    Schedule schedule;
+    std::array<SinOsc, maxSources> sines;
+    std::array<PadSynth, maxSources> pads;
+    std::array<Movement, maxSources> movements;
+
+    std::array<juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear>, numTargets> ramps;
+    std::array<float, maxSources> lastValues {};   // what each source returned at the last update
+
+    Settings settings;
+    float padCutoffCentre = 5000.0f, padCutoffDepth = 4000.0f;         // the cutoff ranges the routes sweep
+    float bounceCutoffCentre = 2000.0f, bounceCutoffDepth = 1000.0f;
+
+    float sampleRate = 44100.0f;
+    int controlInterval = 32;        // Samples between two evaluations of the sources
+    int samplesToNextUpdate = 0;     // Samples left in the current control interval
+    bool isFirstUpdate = true;       // Jump straight to the first targets instead of ramping from zero
+    float padCutoffPosition = 0.0f;  // where the cutoffs were in their ranges at the last evaluation, -1~1
+    float bounceCutoffPosition = 0.0f;
+
+    // Applies the rates to the sources and the ranges to the sweeps
+    void updateRates()
+    {
+        for (int i = 0; i < schedule.numSources; i++)
+        {
+            auto& source = schedule.sources[i];
+            auto rate = source.rateSetting != nullptr ? settings.*source.rateSetting : source.rate;
+            switch (source.type)
+            {
+                case SourceType::pad:       pads[i].setFrequency(rate); break;
+                case SourceType::movement:  movements[i].setFrequency(rate); break;
+                case SourceType::sine:
+                default:                    sines[i].setFrequency(rate); break;
+            }
+        }
+
+        padCutoffCentre = (settings.padCutoffMax + settings.padCutoffMin) / 2;
+        padCutoffDepth = (settings.padCutoffMax - settings.padCutoffMin) / 2;
+        bounceCutoffCentre = (settings.bounceCutoffMax + settings.bounceCutoffMin) / 2;
+        bounceCutoffDepth = (settings.bounceCutoffMax - settings.bounceCutoffMin) / 2;
+    }
+
+    // Returns the sources to the start of their cycles
+    void resetSources()
+    {
+        for (int i = 0; i < schedule.numSources; i++)
+        {
+            sines[i].reset();
+            pads[i].reset();
+            movements[i].reset();
+        }
+        lastValues.fill(0.0f);
+    }
+
+    // Evaluates a source once, with the amount its routes add up to
+    float evaluateSource(int index, float amount)
+    {
+        switch (schedule.sources[index].type)
+        {
+            case SourceType::pad:
+                pads[index].setLFOAmount(amount);
+                return pads[index].process();
+            case SourceType::movement:
+                movements[index].setVibratoAmount(amount);
+                return movements[index].process();
+            case SourceType::sine:
+            default:
+                return sines[index].process();
+        }
+    }
+
+    void setTarget(Target target, float value)
+    {
+        if (isFirstUpdate)
+            ramps[target].setCurrentAndTargetValue(value);
+        else
+            ramps[target].setTargetValue(value);
+    }
+};
@@ -0,0 +1,264 @@
+/*
+  ==============================================================================
+
+    ModulationPatch.h
+    Created: 18 Oct 2026 3:52:08am
+    Author:  70
+
+  ==============================================================================
+*/
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <cmath>
+#include <vector>
+#include "ModulationEngine.h"
+
+/**
+    Reads a modulation patch from JSON and compiles it into the flat schedule ModulationEngine runs.
+
+    A patch lists the modulation sources and the routes from them, e.g. { "sources": [ { "id": "lfo", "type": "sine", "rate": "lfoRate" } ], "routes": [ { "from": "lfo", "to": "padCutoff", "scale": 1, "offset": 0 } ] }. A source's type is "sine", "pad" or "movement" (see ModulationEngine::SourceType). Its rate is either in Hz or the name of one of the rate parameters (lfoRate, lfo2Rate, panRate, movementRate), which the host can then automate; "innerRate", "cutoff" and "amount" set the other fields of ModulationEngine::Source. A route adds from * scale + offset to a target, named as by ModulationEngine::getTargetName(), or to the amount of a pad or movement source, named "<id>.amount". Routes into amounts make sources depend on each other, so compile() sorts the sources topologically, keeping the order of the file where it is free, and rejects sources that modulate each other in a loop. Parsing allocates, so compile on the message thread; the schedule it produces can be handed to the audio thread as it is.
+*/
+class ModulationPatch
+{
+public:
+    // The patch the piece was composed with
+    static const char* getDefault()
+    {
+        return R"({
+  "sources": [
+    { "id": "lfo",      "type": "sine",     "rate": "lfoRate" },
+    { "id": "lfo2",     "type": "pad",      "rate": "lfo2Rate", "innerRate": 20, "cutoff": 5000, "amount": 0.5 },
+    { "id": "volLfo",   "type": "sine",     "rate": "panRate" },
+    { "id": "movement", "type": "movement", "rate": "movementRate", "innerRate": 1, "amount": 0.005 }
+  ],
+  "routes": [
+    { "from": "lfo",      "to": "movement.amount",         "scale": 0.0125,    "offset": 0.0125 },
+    { "from": "movement", "to": "movementLevel" },
+    { "from": "volLfo",   "to": "leftVolume",              "scale": 0.5,       "offset": 0.5 },
+    { "from": "lfo",      "to": "padCutoff" },
+    { "from": "lfo",      "to": "padLFOFrequency",         "scale": 3,         "offset": 3.1 },
+    { "from": "lfo",      "to": "padLFOAmount",            "scale": 0.125,     "offset": 0.125 },
+    { "from": "lfo",      "to": "bounceCutoff" },
+    { "from": "lfo2",     "to": "bounceLFOFrequency",      "scale": 2.5,       "offset": 2.6 },
+    { "from": "lfo2",     "to": "stringRootVolume",        "scale": 0.3333333, "offset": 0.3333333 },
+    { "from": "lfo2",     "to": "stringRootSawAmount",     "scale": 0.5,       "offset": 0.5 },
+    { "from": "lfo",      "to": "stringOctaveUpSawAmount", "scale": 0.25,      "offset": 0.75 },
+    { "from": "lfo2",     "to": "subPulseWidth",           "scale": 0.25,      "offset": 0.25 },
+    { "from": "lfo",      "to": "subSquareAmount",         "scale": 0.25,      "offset": 0.5 },
+    { "from": "lfo",      "to": "subDetuneFine",           "scale": 30 }
+  ]
+})";
+    }
+
+    // Compiles a patch into schedule. If the patch is not valid, returns what is wrong with it and leaves schedule as it was.
+    static juce::Result compile(const juce::String& json, ModulationEngine::Schedule& schedule)
+    {
+        using Step = ModulationEngine::Step;
+
+        juce::var patch;
+        auto parseResult = juce::JSON::parse(json, patch);
+        if (parseResult.failed())
+            return parseResult;
+
+        auto* sourceList = patch["sources"].getArray();
+        auto* routeList = patch["routes"].getArray();
+        if (sourceList == nullptr || routeList == nullptr)
+            return juce::Result::fail("a patch needs a \"sources\" and a \"routes\" list");
+        if (sourceList->size() > ModulationEngine::maxSources)
+            return juce::Result::fail("a patch can have at most " + juce::String(ModulationEngine::maxSources) + " sources");
+        if (sourceList->size() + routeList->size() > ModulationEngine::maxSteps)
+            return juce::Result::fail("a patch can have at most " + juce::String(ModulationEngine::maxSteps - sourceList->size()) + " routes");
+
+        // Sources, in the order of the file
+        juce::StringArray ids;
+        std::array<ModulationEngine::Source, ModulationEngine::maxSources> sources {};
+        for (auto& entry : *sourceList)
+        {
+            auto id = entry["id"].toString();
+            if (id.isEmpty() || ids.contains(id))
+                return juce::Result::fail("every source needs an id of its own, \"" + id + "\" is empty or taken");
+
+            auto result = readSource(entry, sources[(size_t) ids.size()]);
+            if (result.failed())
+                return juce::Result::fail("source \"" + id + "\": " + result.getErrorMessage());
+            ids.add(id);
+        }
+        auto numSources = ids.size();
+
+        // Routes, each feeding either the amount of a source or a target
+        struct Route
+        {
+            int from;
+            int toSource;   // -1 when the route feeds a target
+            int toTarget;   // -1 when the route feeds a source
+            float scale;
+            float offset;
+        };
+
+        std::vector<Route> routes;
+        for (auto& entry : *routeList)
+        {
+            auto from = entry["from"].toString();
+            auto to = entry["to"].toString();
+            Route route { ids.indexOf(from), -1, -1, (float) entry.getProperty("scale", 1.0), (float) entry.getProperty("offset", 0.0) };
+            if (route.from < 0)
+                return juce::Result::fail("the route to \"" + to + "\" reads \"" + from + "\", which is not a source");
+            if (! std::isfinite(route.scale) || ! std::isfinite(route.offset))
+                return juce::Result::fail("the scale or offset of the route to \"" + to + "\" is not a number");
+
+            if (to.endsWith(".amount"))
+            {
+                route.toSource = ids.indexOf(to.dropLastCharacters(7));
+                if (route.toSource < 0 || sources[(size_t) route.toSource].type == ModulationEngine::SourceType::sine)
+                    return juce::Result::fail("\"" + to + "\" is not the amount of a pad or movement source");
+            }
+            else
+            {
+                route.toTarget = findTarget(to);
+                if (route.toTarget < 0)
+                    return juce::Result::fail("\"" + to + "\" is not a target");
+            }
+            routes.push_back(route);
+        }
+
+        // Order the sources so each comes after those routed into its amount (Kahn's algorithm), taking the first
+        // one in the file whenever several are ready
+        std::array<int, ModulationEngine::maxSources> numInputs {};
+        std::array<int, ModulationEngine::maxSources> order {};     // source of the file at each position of the schedule
+        std::array<int, ModulationEngine::maxSources> position;     // position in the schedule of each source of the file
+        position.fill(-1);
+        for (auto& route : routes)
+            if (route.toSource >= 0)
+                ++numInputs[(size_t) route.toSource];
+
+        for (int n = 0; n < numSources; n++)
+        {
+            auto next = -1;
+            for (int i = 0; i < numSources && next < 0; i++)
+                if (position[(size_t) i] < 0 && numInputs[(size_t) i] == 0)
+                    next = i;
+
+            if (next < 0)
+            {
+                juce::StringArray loop;
+                for (int i = 0; i < numSources; i++)
+                    if (position[(size_t) i] < 0)
+                        loop.add(ids[i]);
+                return juce::Result::fail("the sources " + loop.joinIntoString(", ") + " modulate each other in a loop");
+            }
+
+            order[(size_t) n] = next;
+            position[(size_t) next] = n;
+            for (auto& route : routes)
+                if (route.from == next && route.toSource >= 0)
+                    --numInputs[(size_t) route.toSource];
+        }
+
+        // Lay the schedule out: the routes into each source's amount, then the source, then all routes to the targets
+        ModulationEngine::Schedule compiled;
+        auto addStep = [&compiled] (Step::Kind kind, int source, int destination, float scale, float offset)
+        {
+            auto& step = compiled.steps[(size_t) compiled.numSteps++];
+            step.kind = kind;
+            step.source = source;
+            step.destination = destination;
+            step.scale = scale;
+            step.offset = offset;
+        };
+
+        compiled.numSources = numSources;
+        for (int n = 0; n < numSources; n++)
+        {
+            compiled.sources[(size_t) n] = sources[(size_t) order[(size_t) n]];
+            for (auto& route : routes)
+                if (route.toSource == order[(size_t) n])
+                    addStep(Step::routeToAmount, position[(size_t) route.from], n, route.scale, route.offset);
+            addStep(Step::evaluate, n, 0, 1.0f, 0.0f);
+        }
+        for (auto& route : routes)
+            if (route.toTarget >= 0)
+                addStep(Step::routeToTarget, position[(size_t) route.from], route.toTarget, route.scale, route.offset);
+
+        schedule = compiled;
+        return juce::Result::ok();
+    }
+
+private:
+    // Reads the type, rate and settings of a source
+    static juce::Result readSource(const juce::var& entry, ModulationEngine::Source& source)
+    {
+        auto type = entry["type"].toString();
+        if (type == "sine")
+            source.type = ModulationEngine::SourceType::sine;
+        else if (type == "pad")
+            source.type = ModulationEngine::SourceType::pad;
+        else if (type == "movement")
+            source.type = ModulationEngine::SourceType::movement;
+        else
+            return juce::Result::fail("\"" + type + "\" is not a type of source");
+
+        auto rate = entry["rate"];
+        if (rate.isString())
+        {
+            source.rateSetting = findRateSetting(rate.toString());
+            if (source.rateSetting == nullptr)
+                return juce::Result::fail("\"" + rate.toString() + "\" is not a rate parameter");
+        }
+        else if (rate.isInt() || rate.isDouble())
+        {
+            source.rate = (float) rate;
+            if (! isRateInRange(source.rate))
+                return juce::Result::fail("its rate has to be above 0 and below " + juce::String(ModulationEngine::maxSourceRate) + " Hz");
+        }
+        else
+        {
+            return juce::Result::fail("it needs a rate");
+        }
+
+        // The other fields keep their defaults when they are left out
+        auto innerRate = entry["innerRate"];
+        if (! innerRate.isVoid())
+        {
+            source.innerRate = (float) innerRate;
+            if (! isRateInRange(source.innerRate))
+                return juce::Result::fail("its innerRate has to be above 0 and below " + juce::String(ModulationEngine::maxSourceRate) + " Hz");
+        }
+
+        source.cutoff = (float) entry.getProperty("cutoff", source.cutoff);
+        if (! std::isfinite(source.cutoff) || source.cutoff <= 0.0f)
+            return juce::Result::fail("its cutoff has to be above 0 Hz");
+
+        source.amount = (float) entry.getProperty("amount", source.amount);
+        if (! std::isfinite(source.amount))
+            return juce::Result::fail("its amount is not a number");
+        return juce::Result::ok();
+    }
+
+    // Whether a rate is one a source can run at: finite, and above 0 and below the control Nyquist
+    static bool isRateInRange(float rate)
+    {
+        return std::isfinite(rate) && rate > 0.0f && rate < ModulationEngine::maxSourceRate;
+    }
+
+    // Returns the rate in ModulationEngine::Settings a name refers to, or nullptr
+    static float ModulationEngine::Settings::* findRateSetting(const juce::String& name)
+    {
+        using Settings = ModulationEngine::Settings;
+        if (name == "lfoRate")      return &Settings::lfoRate;
+        if (name == "lfo2Rate")     return &Settings::lfo2Rate;
+        if (name == "panRate")      return &Settings::panRate;
+        if (name == "movementRate") return &Settings::movementRate;
+        return nullptr;
+    }
+
+    // Returns the target with a name, or -1
+    static int findTarget(const juce::String& name)
+    {
+        for (int target = 0; target < ModulationEngine::numTargets; target++)
+            if (name == ModulationEngine::getTargetName(ModulationEngine::Target (target)))
+                return target;
+        return -1;
+    }
+};
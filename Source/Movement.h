@@ -49,6 +49,13 @@ public:
         VibratoAmount = VibratoAmt;
     }
     
+    // Keeps the phases of the oscillator and the LFO in fixed point, so they do not drift over long runs
+    void setFixedPointPhase(bool shouldUseFixedPoint)
+    {
+        sinOsc.setFixedPointPhase(shouldUseFixedPoint);
+        vibratoLFO.setFixedPointPhase(shouldUseFixedPoint);
+    }
+    
     // Processes the audio signal, applying vibrato and mixing waveforms
     float process()
     {
@@ -69,6 +76,30 @@ public:
         return sinVal;
 
     }
+    
+    // Moves on by numSamples without processing them, as if process() had been called that often. Every sample runs
+    // the oscillator at baseFrequency * (1 + vibrato * VibratoAmount), so it moves by the number of samples plus the
+    // sum of the vibrato, scaled, in closed form.
+    void skip(juce::int64 numSamples)
+    {
+        if (numSamples <= 0)
+            return;
+        
+        auto vibratoSum = vibratoLFO.sumOfNextSamples(numSamples) * VibratoAmount;
+        vibratoLFO.skip(numSamples);
+        sinOsc.setFrequency(baseFrequency);
+        if (vibratoSum == 0.0)
+            sinOsc.skip(numSamples);
+        else
+            sinOsc.skipCycles((double) baseFrequency / sampleRate * ((double) numSamples + vibratoSum));
+    }
+    
+    // Returns the oscillators to the start of their cycles
+    void reset()
+    {
+        sinOsc.reset();
+        vibratoLFO.reset();
+    }
 private:
     SinOsc sinOsc;
     SinOsc vibratoLFO;
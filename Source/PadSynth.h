@@ -10,6 +10,8 @@
 #pragma once
 
 #include "Oscillators.h"
+#include "StateVariableFilter.h"
+#include "RestGate.h"
 #include <JuceHeader.h>
 
 /**
@@ -22,7 +24,9 @@ class PadSynth
 public:
     PadSynth()
     {
-        updateFilter(filterCutOff); // Initialize the filter with the default cutoff frequency
+        lowPassFilter.setType(StateVariableFilter::Type::LowPass);
+        lowPassFilter.setResonance(1.0f);
+        lowPassFilter.setCutOff(filterCutOff); // Initialize the filter with the default cutoff frequency
     }
     
     // Sets the sample rate for the oscillators and updates the filter
@@ -31,21 +35,29 @@ public:
         sampleRate = SR;
         sinOsc.setSampleRate(sampleRate);
         sinLFO.setSampleRate(sampleRate);
-        updateFilter(filterCutOff);
+        lowPassFilter.setSampleRate(sampleRate);
+        restGate.setSampleRate(sampleRate);
     }
 
-    // Sets the cutoff frequency of the low-pass filter. 
+    // Sets the cutoff frequency of the low-pass filter. The filter keeps its state, so this can be modulated every sample.
     void setFilterCutOff(float CutOffFreq)
     {
         filterCutOff = CutOffFreq;
-        updateFilter(filterCutOff);
+        lowPassFilter.setCutOff(filterCutOff);
     }
     
-    // Sets the frequency of the sine oscillator
+    // Sets the frequency of the sine oscillator; 0 Hz is a rest, during which the synth fades out and goes idle
     void setFrequency(float Freq)
     {
+        // The LFO keeps time through a rest, so it catches up on the samples spent idle
+        if (Freq > 0.0f && idleSamples > 0)
+        {
+            sinLFO.skip(idleSamples);
+            idleSamples = 0;
+        }
         Frequency = Freq;
         sinOsc.setFrequency(Frequency);
+        restGate.setFrequency(Frequency);
     }
 
     // Sets the frequency of the LFO
@@ -60,37 +72,95 @@ public:
     {
         LFOAmount = LFOAmt;
     }
+
+    // Selects how the LFO and the phase-modulated sine are evaluated
+    void setSineBackend(SineBackend backend)
+    {
+        sinOsc.setBackend(backend);
+        sinLFO.setBackend(backend);
+    }
+    
+    // Keeps the phases of the sine and the LFO in fixed point, so they do not drift over long runs
+    void setFixedPointPhase(bool shouldUseFixedPoint)
+    {
+        sinOsc.setFixedPointPhase(shouldUseFixedPoint);
+        sinLFO.setFixedPointPhase(shouldUseFixedPoint);
+    }
     
     // Processes the audio signal, applying LFO modulation and filtering
     float process()
     {
+        // Nothing to render while resting
+        if (restGate.isIdle())
+        {
+            ++idleSamples;
+            return 0.0f;
+        }
+        
         // Calculate the LFO effect for phase modulation
         auto LFOWave = sinLFO.process() * LFOAmount; // LFO output modulates around 0
 
-        // Modulate the sine oscillator's phase
+        // Modulate the sine oscillator's phase (in cycles, so the LFO offset is scaled down by 2 pi)
         auto sinPhase = sinOsc.getPhase();
-        float modulatedPhase = LFOWave + sinPhase * 2.0 * M_PI;
-        float modSinWave = std::sin(modulatedPhase);
+        float modulatedPhase = sinPhase + LFOWave * float (1.0 / (2.0 * M_PI));
+        float modSinWave = FastSine::sinCycles(modulatedPhase, sinOsc.getBackend()) * restGate.getNextGain();
 
         // Mix the raw and filtered waveforms
-        return modSinWave * 0.2 + lowPassFilter.processSingleSampleRaw(modSinWave) * 0.8;
+        float output = modSinWave * 0.2 + lowPassFilter.processSample(modSinWave) * 0.8;
+        
+        // Once a rest has faded and the filter has rung out, clear its state and go idle
+        if (restGate.shouldGoIdle(lowPassFilter.getStateMagnitude()))
+            lowPassFilter.reset();
+        return output;
+    }
+    
+    // Moves on by numSamples without rendering them, as if process() had been called that often. The oscillators
+    // move in closed form and the filter keeps its state, so it needs a few milliseconds of rendering to settle.
+    // A fade into a rest is rendered. The stale filter may let the voice go idle a few samples early or late, but the
+    // LFO keeps time through the rest either way.
+    void skip(juce::int64 numSamples)
+    {
+        for (; numSamples > 0 && restGate.isFadingOut(); --numSamples)
+            process();
+        
+        if (restGate.isIdle())
+            idleSamples += numSamples;
+        if (numSamples <= 0 || restGate.isIdle())
+            return;
+        
+        sinLFO.skip(numSamples);
+        sinOsc.skip(numSamples);
+        restGate.skip(numSamples);
+    }
+    
+    // Approximate sum of the next numSamples outputs, in closed form and without moving on: that of the sine without
+    // its phase modulation, filter and rests. Close for a slow pad used as a modulation source, where the phase
+    // modulation averages out and the filter passes the sine unchanged.
+    double sumOfNextSamples(juce::int64 numSamples) const
+    {
+        return sinOsc.sumOfNextSamples(numSamples);
+    }
+    
+    // Returns the oscillators, filter and rest gate to their state before the first sample
+    void reset()
+    {
+        sinOsc.reset();
+        sinLFO.reset();
+        lowPassFilter.reset();
+        restGate.reset();
+        idleSamples = 0;
     }
 private:
     SinOsc sinOsc;
     SinOsc sinLFO;
-    juce::IIRFilter lowPassFilter;
+    StateVariableFilter lowPassFilter;
+    RestGate restGate;
+    juce::int64 idleSamples = 0;  // samples spent idle in the current rest
     
     float sampleRate = 44100.0f;
     float Frequency = 440.0f;
     float LFOFrequency = 5.0f;    // Default LFO frequency
     float LFOAmount = 0.5f;       // Default LFO modulation amount
     float filterCutOff = 5000.0f; // Default filter cutoff frequency
-
-    // Updates the low-pass filter's coefficients based on the current cutoff frequency
-    void updateFilter(float cutoffFrequency)
-    {
-        lowPassFilter.setCoefficients(juce::IIRCoefficients::makeLowPass(sampleRate, cutoffFrequency, 1.0));
-        lowPassFilter.reset();
-    }
 };
 
@@ -0,0 +1,349 @@
+/*
+  ==============================================================================
+
+    PadSynthBank.h
+    Created: 17 Oct 2026 1:42:08pm
+    Author:  70
+
+  ==============================================================================
+*/
+#pragma once
+
+#include "StateVariableFilter.h"
+#include "Oscillators.h"
+#include <JuceHeader.h>
+#include <cmath>
+
+/**
+    Renders several PadSynth voices at once, one voice per SIMD lane.
+
+    PadSynthBank follows the same maths as PadSynth::process() (a sine LFO driving the phase modulation of a sine, mixed with a TPT low-pass of itself), but keeps every voice's state in structure-of-arrays form: oscillator phases, LFO phases and filter states are arrays that are loaded into juce::dsp::SIMDRegister lanes and advanced together. A group of four voices costs roughly what one scalar voice used to, and the groups are added up lane by lane, so each sample is summed across the lanes only once. Each lane also has a linear gain envelope (setVoiceGain()), and groups whose lanes are all silent are skipped, so idle voices cost nothing. With setFixedPointPhase(), the phases are also kept in fixed point (see FixedPhase) and each process() call starts the float lanes from them, so the float rounding never adds up over more than one block. Initialize with setSampleRate(), set the per-voice frequencies with setFrequency() and the shared LFO and filter settings, then call process() to render the sum of all voices.
+*/
+template <int NumVoices>
+class PadSynthBank
+{
+public:
+    using Register = juce::dsp::SIMDRegister<float>;
+
+    static constexpr int numLanes = (int) Register::SIMDNumElements;
+    static constexpr int numGroups = (NumVoices + numLanes - 1) / numLanes;
+    static constexpr int numSlots = numGroups * numLanes; // voices rounded up to whole registers
+
+    PadSynthBank()
+    {
+        for (int v = 0; v < numSlots; ++v)
+        {
+            // Voices start fully on; padding lanes stay silent
+            gain[v] = gainLow[v] = gainHigh[v] = v < NumVoices ? 1.0f : 0.0f;
+            gainStep[v] = 0.0f;
+        }
+        reset();
+        updateCoefficients();
+    }
+
+    static constexpr int getNumVoices() { return NumVoices; }
+
+    // Sets the sample rate for all voices and updates the filter
+    void setSampleRate(float SR)
+    {
+        sampleRate = SR;
+        for (int v = 0; v < NumVoices; ++v)
+            setFrequency(v, frequency[v]);
+        setLFOFrequency(LFOFrequency);
+        updateCoefficients();
+    }
+
+    // Sets the frequency of one voice
+    void setFrequency(int voice, float Freq)
+    {
+        frequency[voice] = Freq;
+        phaseDelta[voice] = Freq / sampleRate;
+        fixedPhaseDelta[voice] = FixedPhase::fromCycles((double) Freq / sampleRate);
+    }
+
+    float getFrequency(int voice) const
+    {
+        return frequency[voice];
+    }
+
+    // Sets the frequency of the phase modulation LFO, shared by all voices
+    void setLFOFrequency(float LFOFreq)
+    {
+        LFOFrequency = LFOFreq;
+        lfoDelta = LFOFrequency / sampleRate;
+        fixedLfoDelta = FixedPhase::fromCycles((double) LFOFrequency / sampleRate);
+    }
+
+    // Keeps the oscillator and LFO phases in fixed point, so they do not drift over long runs. The current phases
+    // carry over.
+    void setFixedPointPhase(bool shouldUseFixedPoint)
+    {
+        isFixedPoint = shouldUseFixedPoint;
+        for (int v = 0; v < numSlots; ++v)
+        {
+            fixedPhase[v] = FixedPhase::fromCycles(phase[v]);
+            fixedLfoPhase[v] = FixedPhase::fromCycles(lfoPhase[v]);
+        }
+    }
+
+    // Sets the amount of LFO modulation, shared by all voices
+    void setLFOAmount(float LFOAmt) // Amount range 0~1
+    {
+        LFOAmount = LFOAmt;
+    }
+
+    // Sets the cutoff frequency of the low-pass filters, shared by all voices
+    void setFilterCutOff(float CutOffFreq)
+    {
+        filterCutOff = CutOffFreq;
+        updateCoefficients();
+    }
+
+    // Ramps the gain of one voice linearly to target over rampSamples samples, or jumps when rampSamples is 0
+    void setVoiceGain(int voice, float target, int rampSamples)
+    {
+        if (rampSamples <= 0)
+            gain[voice] = target;
+
+        gainStep[voice] = (target - gain[voice]) / (float) juce::jmax(1, rampSamples);
+        gainLow[voice] = juce::jmin(gain[voice], target);
+        gainHigh[voice] = juce::jmax(gain[voice], target);
+    }
+
+    float getVoiceGain(int voice) const
+    {
+        return gain[voice];
+    }
+
+    // Clears the oscillator, LFO and filter states of one voice
+    void resetVoice(int voice)
+    {
+        phase[voice] = 0.0f;
+        lfoPhase[voice] = 0.0f;
+        fixedPhase[voice] = 0;
+        fixedLfoPhase[voice] = 0;
+        ic1eq[voice] = 0.0f;
+        ic2eq[voice] = 0.0f;
+    }
+
+    // Clears the oscillator, LFO and filter states of all voices
+    void reset()
+    {
+        for (int v = 0; v < numSlots; ++v)
+            resetVoice(v);
+    }
+
+    // Renders numSamples samples, writing the sum of all voices to out
+    void process(float* out, int numSamples)
+    {
+        // Which groups sound is decided once per call, so a group renders either all of it or none of it
+        bool isGroupActive[numGroups];
+        for (int g = 0; g < numGroups; ++g)
+        {
+            isGroupActive[g] = ! isGroupSilent(g * numLanes);
+            if (isGroupActive[g] && isFixedPoint)
+                loadFixedPhases(g * numLanes);
+        }
+
+        // The groups of a chunk are added up lane by lane, and each sample is summed across the lanes once at the end
+        for (int start = 0; start < numSamples; start += chunkSize)
+        {
+            auto chunkLength = juce::jmin(chunkSize, numSamples - start);
+            Register sums[chunkSize];
+            for (int i = 0; i < chunkLength; ++i)
+                sums[i] = Register::expand(0.0f);
+
+            for (int g = 0; g < numGroups; ++g)
+            {
+                if (isGroupActive[g])
+                    processGroup(g * numLanes, sums, chunkLength);
+            }
+
+            for (int i = 0; i < chunkLength; ++i)
+                out[start + i] = sums[i].sum();
+        }
+
+        for (int g = 0; g < numGroups; ++g)
+        {
+            if (isGroupActive[g] && isFixedPoint)
+                skipFixedPhases(g * numLanes, numSamples);
+        }
+    }
+
+    // Moves on by numSamples without rendering them, as if process() had been called once for all of them. Phases
+    // and gain envelopes move in closed form; the filters keep their state, so they need a few milliseconds of
+    // rendering to settle.
+    void skip(juce::int64 numSamples)
+    {
+        for (int g = 0; g < numGroups; ++g)
+        {
+            auto offset = g * numLanes;
+            if (isGroupSilent(offset))
+                continue;
+
+            if (isFixedPoint)
+                skipFixedPhases(offset, numSamples);
+
+            for (int v = offset; v < offset + numLanes; ++v)
+            {
+                if (! isFixedPoint)
+                {
+                    phase[v] = skipped(phase[v], phaseDelta[v], numSamples);
+                    lfoPhase[v] = skipped(lfoPhase[v], lfoDelta, numSamples);
+                }
+                gain[v] = (float) juce::jlimit((double) gainLow[v], (double) gainHigh[v], gain[v] + (double) numSamples * gainStep[v]);
+            }
+        }
+    }
+
+private:
+    static constexpr size_t alignment = Register::SIMDRegisterSize;
+
+    // Structure of arrays, one entry per lane
+    alignas(alignment) float phase[numSlots] {};
+    alignas(alignment) float phaseDelta[numSlots] {};
+    alignas(alignment) float lfoPhase[numSlots] {};
+    alignas(alignment) float ic1eq[numSlots] {};
+    alignas(alignment) float ic2eq[numSlots] {};
+    alignas(alignment) float gain[numSlots] {};
+    alignas(alignment) float gainStep[numSlots] {};
+    alignas(alignment) float gainLow[numSlots] {};
+    alignas(alignment) float gainHigh[numSlots] {};
+    float frequency[numSlots] {};
+
+    // The phases in fixed point, which the float phases start from in each block when isFixedPoint is set
+    bool isFixedPoint = false;
+    juce::uint32 fixedPhase[numSlots] {};
+    juce::uint32 fixedPhaseDelta[numSlots] {};
+    juce::uint32 fixedLfoPhase[numSlots] {};
+    juce::uint32 fixedLfoDelta = 0;
+
+    float sampleRate = 44100.0f;
+    float LFOFrequency = 5.0f;    // Default LFO frequency
+    float LFOAmount = 0.5f;       // Default LFO modulation amount
+    float filterCutOff = 5000.0f; // Default filter cutoff frequency
+    float lfoDelta = 5.0f / 44100.0f;
+    float a1 = 0.0f, a2 = 0.0f, a3 = 0.0f;
+
+    static constexpr int chunkSize = 64;   // samples whose lane sums are kept in registers at once
+
+    // A group can be skipped when none of its lanes is sounding or about to sound
+    bool isGroupSilent(int offset) const
+    {
+        for (int lane = offset; lane < offset + numLanes; ++lane)
+            if (gain[lane] > 0.0f || gainStep[lane] > 0.0f)
+                return false;
+        return true;
+    }
+
+    // Renders numSamples samples of the voices of the group at offset, adding each sample's lanes to sums
+    void processGroup(int offset, Register* sums, int numSamples)
+    {
+        auto lfoStep = Register::expand(lfoDelta);
+        auto lfoDepth = Register::expand(LFOAmount * float (1.0 / (2.0 * M_PI))); // LFO offset in cycles
+        auto coefficient1 = Register::expand(a1);
+        auto coefficient2 = Register::expand(a2);
+        auto coefficient3 = Register::expand(a3);
+        auto two = Register::expand(2.0f);
+        auto rawMix = Register::expand(0.2f);
+        auto filteredMix = Register::expand(0.8f);
+
+        auto oscPhase = Register::fromRawArray(phase + offset);
+        auto oscStep = Register::fromRawArray(phaseDelta + offset);
+        auto modPhase = Register::fromRawArray(lfoPhase + offset);
+        auto state1 = Register::fromRawArray(ic1eq + offset);
+        auto state2 = Register::fromRawArray(ic2eq + offset);
+        auto level = Register::fromRawArray(gain + offset);
+        auto levelStep = Register::fromRawArray(gainStep + offset);
+        auto levelLow = Register::fromRawArray(gainLow + offset);
+        auto levelHigh = Register::fromRawArray(gainHigh + offset);
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            // Calculate the LFO effect for phase modulation
+            modPhase = wrap(modPhase + lfoStep);
+            auto LFOWave = sine(modPhase) * lfoDepth;
+
+            // Modulate the sine oscillator's phase
+            oscPhase = wrap(oscPhase + oscStep);
+            auto modSinWave = sine(oscPhase + LFOWave);
+
+            // Low-pass filter, same TPT structure as StateVariableFilter
+            auto v3 = modSinWave - state2;
+            auto v1 = coefficient1 * state1 + coefficient2 * v3;
+            auto v2 = state2 + coefficient2 * state1 + coefficient3 * v3;
+            state1 = two * v1 - state1;
+            state2 = two * v2 - state2;
+
+            // Mix the raw and filtered waveforms and apply the voice envelopes
+            level = Register::min(Register::max(level + levelStep, levelLow), levelHigh);
+            sums[i] += (modSinWave * rawMix + v2 * filteredMix) * level;
+        }
+
+        level.copyToRawArray(gain + offset);
+        oscPhase.copyToRawArray(phase + offset);
+        modPhase.copyToRawArray(lfoPhase + offset);
+        state1.copyToRawArray(ic1eq + offset);
+        state2.copyToRawArray(ic2eq + offset);
+    }
+
+    // Starts the float phases of a group from the fixed-point ones
+    void loadFixedPhases(int offset)
+    {
+        for (int v = offset; v < offset + numLanes; ++v)
+        {
+            phase[v] = FixedPhase::toCycles(fixedPhase[v]);
+            lfoPhase[v] = FixedPhase::toCycles(fixedLfoPhase[v]);
+        }
+    }
+
+    // Moves the fixed-point phases of a group on by numSamples, exactly
+    void skipFixedPhases(int offset, juce::int64 numSamples)
+    {
+        for (int v = offset; v < offset + numLanes; ++v)
+        {
+            fixedPhase[v] += (juce::uint32) ((juce::uint64) numSamples * fixedPhaseDelta[v]);
+            fixedLfoPhase[v] += (juce::uint32) ((juce::uint64) numSamples * fixedLfoDelta);
+        }
+        loadFixedPhases(offset);
+    }
+
+    // A phase moved on by numSamples steps, without its whole cycles
+    static float skipped(float p, float step, juce::int64 numSamples)
+    {
+        auto moved = p + (double) numSamples * step;
+        return (float) (moved - std::floor(moved));
+    }
+
+    // Removes the whole cycles from phases that are known to be positive
+    static Register wrap(Register p)
+    {
+        return p - Register::truncate(p);
+    }
+
+    // sin(2 * pi * p) for p > -64, evaluated with the odd minimax polynomial of FastSine::polynomial().
+    // sin(2 pi p) = cos(2 pi t) with t = p - 1/4 reduced to -0.5~0.5, and cos(2 pi t) = sin(2 pi (1/4 - |t|)).
+    static Register sine(Register p)
+    {
+        auto q = p - Register::expand(0.25f);
+        auto t = q - (Register::truncate(q + Register::expand(64.5f)) - Register::expand(64.0f));
+        auto z = Register::expand(0.25f) - Register::abs(t);
+        auto z2 = z * z;
+        auto poly = Register::expand(39.53670607f);
+        poly = poly * z2 + Register::expand(-76.54978229f);
+        poly = poly * z2 + Register::expand(81.60100407f);
+        poly = poly * z2 + Register::expand(-41.34165503f);
+        poly = poly * z2 + Register::expand(6.283185160f);
+        return poly * z;
+    }
+
+    // The pad filter has a Q of 1, as in PadSynth
+    void updateCoefficients()
+    {
+        auto g = StateVariableFilter::getWarpedGain(filterCutOff, sampleRate);
+        auto k = 1.0f;
+        a1 = 1.0f / (1.0f + g * (g + k));
+        a2 = g * a1;
+        a3 = g * a2;
+    }
+};
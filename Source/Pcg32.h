@@ -0,0 +1,67 @@
+/*
+  ==============================================================================
+
+    Pcg32.h
+    Created: 18 Oct 2026 12:21:05am
+    Author:  70
+
+  ==============================================================================
+*/
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+    A small, fast random number generator with no shared state, for use on the audio thread.
+
+    Pcg32 is O'Neill's PCG-XSH-RR generator: a 64-bit linear congruential state whose top bits are xor-shifted and rotated into each 32-bit output. Each instance owns its 16 bytes of state, so generators on different threads never touch each other, and the same seed and stream always produce the same numbers on every platform. Different streams with the same seed give independent sequences, which lets one seed drive several generators. Seed with setSeed(), then call nextUint32() or nextInt().
+*/
+class Pcg32
+{
+public:
+    Pcg32()
+    {
+        setSeed(0);
+    }
+
+    // Restarts the generator from seed, on one of 2^63 independent streams
+    void setSeed(juce::uint64 seed, juce::uint64 stream = 0)
+    {
+        increment = (stream << 1) | 1u;
+        state = 0;
+        nextUint32();
+        state += seed;
+        nextUint32();
+    }
+
+    // Returns the next 32 random bits
+    juce::uint32 nextUint32()
+    {
+        auto oldState = state;
+        state = oldState * 6364136223846793005ULL + increment;
+        auto xorShifted = (juce::uint32) (((oldState >> 18) ^ oldState) >> 27);
+        auto rotation = (juce::uint32) (oldState >> 59);
+        return (xorShifted >> rotation) | (xorShifted << ((32 - rotation) & 31));
+    }
+
+    // Returns a uniformly distributed integer from 0 to maxValue - 1, without modulo bias
+    int nextInt(int maxValue)
+    {
+        jassert(maxValue > 0);
+        auto range = (juce::uint32) maxValue;
+
+        // Lemire's method: the high half of a 32x32 bit product, rejecting the few values that would bias it
+        auto product = (juce::uint64) nextUint32() * range;
+        if ((juce::uint32) product < range)
+        {
+            auto threshold = (0u - range) % range;
+            while ((juce::uint32) product < threshold)
+                product = (juce::uint64) nextUint32() * range;
+        }
+        return (int) (product >> 32);
+    }
+
+private:
+    juce::uint64 state = 0;
+    juce::uint64 increment = 1;
+};
@@ -0,0 +1,264 @@
+/*
+  ==============================================================================
+
+    PipelinedReverb.h
+    Created: 17 Oct 2026 10:41:18pm
+    Author:  70
+
+  ==============================================================================
+*/
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+#include "FDNReverb.h"
+#include "LockFreeExchange.h"
+
+/**
+    An FDNReverb that can run on its own thread, one block behind the audio thread.
+
+    When pipelining is off, processStereo() simply runs the reverb in place. When it is on, processStereo() copies the block into a lock-free ring buffer, wakes a high-priority worker thread if it is asleep, and returns the reverb's output for the samples it was given one block earlier. The worker reverbs whatever is waiting in the input ring and writes it to an output ring, which starts out holding one block of silence. The output is therefore delayed by exactly getLatencySamples(), as long as the worker keeps up. If it falls behind, the missing samples are played as silence and the late ones are dropped when they arrive, so the delay stays the same. Offline renders can ask processStereo() to wait for the worker instead, so they never lose samples. Parameters can be changed from any single thread through a LockFreeExchange and are picked up by whichever thread runs the reverb; the tail length they give is published in an atomic for the host. Set up with prepare() from a non-real-time thread.
+*/
+class PipelinedReverb : private juce::Thread
+{
+public:
+    using Parameters = FDNReverb::Parameters;
+
+    PipelinedReverb()
+        : juce::Thread("Reverb worker")
+    {
+    }
+
+    ~PipelinedReverb() override
+    {
+        stop();
+    }
+
+    // Sets the reverb up for a sample rate and block size and clears it. With runOnWorker, starts the worker
+    // thread and delays the output by one block. Not real-time safe.
+    void prepare(double SR, int maximumBlockSize, bool runOnWorker)
+    {
+        stop();
+
+        sampleRate = SR;
+        reverb.setParameters(parameters);
+        reverb.setSampleRate(SR);   // also settles the parameters without a ramp
+        blockSize = juce::jmax(1, maximumBlockSize);
+        isPipelined = runOnWorker;
+        updateTailLength();
+        if (! isPipelined)
+            return;
+
+        // Room for a few blocks in each direction, so a late worker does not overflow the rings
+        auto capacity = 4 * blockSize + 1;
+        inputFifo.setTotalSize(capacity);
+        outputFifo.setTotalSize(capacity);
+        inputRing.setSize(2, capacity);
+        outputRing.setSize(2, capacity);
+        scratch.setSize(2, blockSize);
+        inputRing.clear();
+        outputRing.clear();
+        inputFifo.reset();
+        outputFifo.reset();
+        outputBalance = 0;
+
+        // One block of silence ahead of the first reverbed block sets the latency
+        int start1, size1, start2, size2;
+        outputFifo.prepareToWrite(blockSize, start1, size1, start2, size2);
+        outputFifo.finishedWrite(size1 + size2);
+
+        startThread(juce::Thread::Priority::highest);
+    }
+
+    // Stops the worker thread, if it runs. Not real-time safe.
+    void stop()
+    {
+        signalThreadShouldExit();
+        inputAvailable.signal();
+        stopThread(1000);
+    }
+
+    // Sets new reverb parameters. Call from one thread only.
+    void setParameters(const Parameters& newParams)
+    {
+        parameters = newParams;
+        pendingParameters.push(newParams);
+        updateTailLength();
+    }
+
+    const Parameters& getParameters() const
+    {
+        return parameters;
+    }
+
+    // Turns the reverb's tap modulation on or off (see FDNReverb::setTapModulation()). Safe to call from any thread;
+    // picked up with the parameters.
+    void setTapModulation(bool shouldModulate)
+    {
+        tapModulation = shouldModulate;
+    }
+
+    // Turns the reverb's tap modulation to where it is numSamples after prepare(), for a caller that jumps ahead in its
+    // input. When pipelined, the worker picks it up before the next samples it reverbs. Call from the audio thread.
+    void setModulationPosition(juce::int64 numSamples)
+    {
+        if (isPipelined)
+            pendingModulationPosition = numSamples;
+        else
+            reverb.setModulationPosition(numSamples);
+    }
+
+    // Delay of the output in samples: one block when pipelined, otherwise none
+    int getLatencySamples() const
+    {
+        return isPipelined ? blockSize : 0;
+    }
+
+    // Time from the last input until the output has fallen by 60 dB, including the latency. Safe to call from any thread.
+    double getTailLengthSeconds() const
+    {
+        return tailLengthSeconds.load();
+    }
+
+    // Audio thread: applies the reverb to a stereo block. When pipelined, the output is the reverb of the input one
+    // block earlier. With waitForWorker, blocks until the worker has delivered it, as offline renders should.
+    void processStereo(float* const left, float* const right, const int numSamples, bool waitForWorker)
+    {
+        if (! isPipelined)
+        {
+            pullParameters();
+            reverb.processStereo(left, right, numSamples);
+            return;
+        }
+
+        // Hand the block to the worker. If the ring is full, the dropped samples will never come back. Signalling takes
+        // a lock, so the worker is only woken when it sleeps.
+        auto numWritten = write(inputFifo, inputRing, left, right, numSamples);
+        outputBalance -= numSamples - numWritten;
+        if (workerSleeping.load())
+            inputAvailable.signal();
+
+        if (waitForWorker)
+            while (outputFifo.getNumReady() < numSamples + juce::jmax(0, outputBalance) && isThreadRunning())
+                outputAvailable.wait(100);
+
+        // Drop samples the worker delivered too late to be played
+        if (outputBalance > 0)
+        {
+            auto numLate = juce::jmin(outputBalance, outputFifo.getNumReady());
+            int start1, size1, start2, size2;
+            outputFifo.prepareToRead(numLate, start1, size1, start2, size2);
+            outputFifo.finishedRead(size1 + size2);
+            outputBalance -= numLate;
+        }
+
+        // Play what has arrived and silence for the rest
+        auto numRead = read(outputFifo, outputRing, left, right, numSamples);
+        for (int i = numRead; i < numSamples; ++i)
+            left[i] = right[i] = 0.0f;
+        outputBalance += numSamples - numRead;
+    }
+
+private:
+    FDNReverb reverb;
+    Parameters parameters;                          // owned by the thread that sets them
+    LockFreeExchange<Parameters> pendingParameters; // picked up by the thread that runs the reverb
+    std::atomic<juce::int64> pendingModulationPosition { -1 }; // picked up by the worker, -1 when there is none
+    std::atomic<bool> tapModulation { true };       // picked up by the thread that runs the reverb
+    std::atomic<double> tailLengthSeconds { 0.0 };  // read by the host from any thread
+
+    double sampleRate = 44100.0;
+    int blockSize = 512;
+    bool isPipelined = false;
+
+    juce::AbstractFifo inputFifo { 1 };
+    juce::AbstractFifo outputFifo { 1 };
+    juce::AudioBuffer<float> inputRing;             // audio thread to worker
+    juce::AudioBuffer<float> outputRing;            // worker to audio thread
+    juce::AudioBuffer<float> scratch;               // owned by the worker
+    int outputBalance = 0;                          // owned by the audio thread: late samples to drop, or missing ones if negative
+
+    juce::WaitableEvent inputAvailable;
+    juce::WaitableEvent outputAvailable;
+    std::atomic<bool> workerSleeping { false };     // set by the worker while it waits for input
+
+    void updateTailLength()
+    {
+        tailLengthSeconds = FDNReverb::getDecayTime(parameters) + getLatencySamples() / sampleRate;
+    }
+
+    // Samples the worker can reverb now: those waiting, as far as the output ring has room
+    int getNumSamplesToProcess() const
+    {
+        return juce::jmin(inputFifo.getNumReady(), outputFifo.getFreeSpace(), blockSize);
+    }
+
+    void pullParameters()
+    {
+        Parameters newParams;
+        if (pendingParameters.pull(newParams))
+            reverb.setParameters(newParams);
+
+        auto shouldModulate = tapModulation.load();
+        if (shouldModulate != reverb.isTapModulated())
+            reverb.setTapModulation(shouldModulate);
+    }
+
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            // Reverb everything that is waiting, as far as the output ring has room
+            for (;;)
+            {
+                auto numSamples = getNumSamplesToProcess();
+                if (numSamples <= 0)
+                    break;
+
+                auto* left = scratch.getWritePointer(0);
+                auto* right = scratch.getWritePointer(1);
+                read(inputFifo, inputRing, left, right, numSamples);
+                pullParameters();
+                auto modulationPosition = pendingModulationPosition.exchange(-1);
+                if (modulationPosition >= 0)
+                    reverb.setModulationPosition(modulationPosition);
+                reverb.processStereo(left, right, numSamples);
+                write(outputFifo, outputRing, left, right, numSamples);
+                outputAvailable.signal();
+            }
+
+            // Sleep until the audio thread signals. The flag is raised before the last look at the rings, so a block
+            // handed over in between is either seen here or signalled.
+            workerSleeping = true;
+            if (getNumSamplesToProcess() <= 0 && ! threadShouldExit())
+                inputAvailable.wait(100);
+            workerSleeping = false;
+        }
+    }
+
+    // Copies up to numSamples into a ring and returns how many fitted
+    static int write(juce::AbstractFifo& fifo, juce::AudioBuffer<float>& ring, const float* left, const float* right, int numSamples)
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite(numSamples, start1, size1, start2, size2);
+        ring.copyFrom(0, start1, left, size1);
+        ring.copyFrom(1, start1, right, size1);
+        ring.copyFrom(0, start2, left + size1, size2);
+        ring.copyFrom(1, start2, right + size1, size2);
+        fifo.finishedWrite(size1 + size2);
+        return size1 + size2;
+    }
+
+    // Copies up to numSamples out of a ring and returns how many were there
+    static int read(juce::AbstractFifo& fifo, const juce::AudioBuffer<float>& ring, float* left, float* right, int numSamples)
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(numSamples, start1, size1, start2, size2);
+        juce::FloatVectorOperations::copy(left, ring.getReadPointer(0, start1), size1);
+        juce::FloatVectorOperations::copy(right, ring.getReadPointer(1, start1), size1);
+        juce::FloatVectorOperations::copy(left + size1, ring.getReadPointer(0, start2), size2);
+        juce::FloatVectorOperations::copy(right + size1, ring.getReadPointer(1, start2), size2);
+        fifo.finishedRead(size1 + size2);
+        return size1 + size2;
+    }
+};
@@ -15,11 +15,17 @@ AP_Assignment2AudioProcessorEditor::AP_Assignment2AudioProcessorEditor (AP_Assig
 {
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
-    setSize (400, 300);
+    setSize (400, 330);
+    
+    // Show where the CPU goes while the editor is open
+    audioProcessor.setProfilingEnabled (true);
+    startTimerHz (4);
 }
 
 AP_Assignment2AudioProcessorEditor::~AP_Assignment2AudioProcessorEditor()
 {
+    stopTimer();
+    audioProcessor.setProfilingEnabled (false);
 }
 
 //==============================================================================
@@ -30,7 +36,33 @@ void AP_Assignment2AudioProcessorEditor::paint (juce::Graphics& g)
 
     g.setColour (juce::Colours::white);
     g.setFont (15.0f);
-    g.drawFittedText ("Hello World!", getLocalBounds(), juce::Justification::centred, 1);
+    
+    // CPU use of each stage, as a share of the real-time budget
+    auto area = getLocalBounds().reduced (20);
+    
+    auto drawRow = [&g, &area] (const juce::String& name, const juce::String& average, const juce::String& peak)
+    {
+        auto row = area.removeFromTop (24);
+        g.drawText (name, row.removeFromLeft (170), juce::Justification::centredLeft);
+        g.drawText (average, row.removeFromLeft (80), juce::Justification::centredRight);
+        g.drawText (peak, row.removeFromLeft (80), juce::Justification::centredRight);
+    };
+    
+    auto toPercent = [] (float load) { return juce::String (load * 100.0f, 1) + " %"; };
+    
+    drawRow ("CPU load", "average", "peak");
+    
+    for (int stage = 0; stage < AP_Assignment2AudioProcessor::numStages; ++stage)
+    {
+        auto& load = profile.stages[stage];
+        drawRow (AP_Assignment2AudioProcessor::getStageName (AP_Assignment2AudioProcessor::Stage (stage)),
+                 toPercent (load.average), toPercent (load.peak));
+    }
+    
+    drawRow ("Total", toPercent (profile.total.average), toPercent (profile.total.peak));
+    
+    // Steps the quality governor has taken below full quality, and the blocks that missed their deadline
+    drawRow ("Quality level / overruns", juce::String (quality.level), juce::String (quality.numOverruns));
 }
 
 void AP_Assignment2AudioProcessorEditor::resized()
@@ -38,3 +70,15 @@ void AP_Assignment2AudioProcessorEditor::resized()
     // This is generally where you'll want to lay out the positions of any
     // subcomponents in your editor..
 }
+
+void AP_Assignment2AudioProcessorEditor::timerCallback()
+{
+    // Keep showing the last values while no audio is processed
+    auto snapshot = audioProcessor.getProfilerSnapshot();
+    if (snapshot.numBlocks > 0)
+    {
+        profile = snapshot;
+        quality = audioProcessor.getQualitySnapshot();
+        repaint();
+    }
+}
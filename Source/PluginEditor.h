@@ -14,7 +14,8 @@
 //==============================================================================
 /**
 */
-class AP_Assignment2AudioProcessorEditor  : public juce::AudioProcessorEditor
+class AP_Assignment2AudioProcessorEditor  : public juce::AudioProcessorEditor,
+                                            private juce::Timer
 {
 public:
     AP_Assignment2AudioProcessorEditor (AP_Assignment2AudioProcessor&);
@@ -25,6 +26,13 @@ public:
     void resized() override;
 
 private:
+    // Collects the latest CPU measurement from the processor
+    void timerCallback() override;
+    
+    AP_Assignment2AudioProcessor::Profiler::Snapshot profile;
+    QualityGovernor::Snapshot quality;
+    
+
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
     AP_Assignment2AudioProcessor& audioProcessor;
@@ -8,8 +8,54 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include <algorithm>
 #include <cmath>
-#include "vector"
+#include <limits>
+
+namespace
+{
+    // Identifier, name, range and default of each parameter, in the order of AP_Assignment2AudioProcessor::Parameter.
+    // A skew centre of 0 keeps the range linear.
+    struct ParameterInfo
+    {
+        const char* id;
+        const char* name;
+        float minimum;
+        float maximum;
+        float defaultValue;
+        float skewCentre;
+    };
+    
+    const ParameterInfo parameterInfo[] =
+    {
+        { "padChordsLevel",      "Pad chords level",        0.0f,     2.0f,     1.0f,    0.0f },
+        { "bounceLevel",         "Bounce level",            0.0f,     1.0f,     0.4f,    0.0f },
+        { "embellishmentLevel",  "Embellishment level",     0.0f,     1.0f,     0.1f,    0.0f },
+        { "stringOctaveUpLevel", "String octave up level",  0.0f,     1.0f,     0.9f,    0.0f },
+        { "subbassLevel",        "Subbass level",           0.0f,     1.0f,     0.3f,    0.0f },
+        { "reverbRoomSize",      "Reverb room size",        0.0f,     1.0f,     0.9f,    0.0f },
+        { "reverbDamping",       "Reverb damping",          0.0f,     1.0f,     0.5f,    0.0f },
+        { "reverbWetLevel",      "Reverb wet level",        0.0f,     1.0f,     0.05f,   0.0f },
+        { "reverbDryLevel",      "Reverb dry level",        0.0f,     1.0f,     0.5f,    0.0f },
+        { "reverbWidth",         "Reverb width",            0.0f,     1.0f,     1.0f,    0.0f },
+        { "chordsHold",          "Chord hold (s)",          0.05f,    30.0f,    6.4f,    2.0f },
+        { "leftBounceHold",      "Left bounce hold (s)",    0.05f,    30.0f,    6.4f,    2.0f },
+        { "rightBounceHold",     "Right bounce hold (s)",   0.05f,    30.0f,    3.2f,    2.0f },
+        { "stringHold",          "String hold (s)",         0.05f,    30.0f,    0.8f,    2.0f },
+        { "embellishmentHold",   "Embellishment hold (s)",  0.05f,    30.0f,    0.4f,    2.0f },
+        { "lfoRate",             "Filter LFO rate (Hz)",    0.01f,    10.0f,    0.4f,    1.0f },
+        { "lfo2Rate",            "Timbre LFO rate (Hz)",    0.01f,    10.0f,    0.4f,    1.0f },
+        { "panRate",             "Pan rate (Hz)",           0.01f,    10.0f,    1.0f,    1.0f },
+        { "movementRate",        "Movement rate (Hz)",      0.1f,     20.0f,    5.0f,    2.0f },
+        { "stringVibratoRate",   "String vibrato (Hz)",     0.0f,     10.0f,    5.0f,    0.0f },
+        { "padCutoffMin",        "Pad cutoff min (Hz)",     20.0f,    20000.0f, 1000.0f, 1000.0f },
+        { "padCutoffMax",        "Pad cutoff max (Hz)",     20.0f,    20000.0f, 9000.0f, 1000.0f },
+        { "bounceCutoffMin",     "Bounce cutoff min (Hz)",  20.0f,    20000.0f, 1000.0f, 1000.0f },
+        { "bounceCutoffMax",     "Bounce cutoff max (Hz)",  20.0f,    20000.0f, 3000.0f, 1000.0f },
+        { "bounceResonance",     "Bounce resonance",        0.5f,     10.0f,    5.0f,    0.0f },
+    };
+    static_assert(std::size(parameterInfo) == AP_Assignment2AudioProcessor::numParameters, "One entry per parameter");
+}
 
 //==============================================================================
 AP_Assignment2AudioProcessor::AP_Assignment2AudioProcessor()
@@ -24,6 +70,22 @@ AP_Assignment2AudioProcessor::AP_Assignment2AudioProcessor()
                        )
 #endif
 {
+    for (int i = 0; i < numParameters; i++)
+    {
+        parameterValues[i] = parameters.getRawParameterValue(parameterInfo[i].id);
+        parameterObjects[i] = parameters.getParameter(parameterInfo[i].id);
+    }
+    
+    for (auto& parameter : controllerParameters)
+        parameter = numParameters;
+    controllerParameters[74] = padCutoffMax;
+    controllerParameters[91] = reverbWetLevel;
+    
+    initialiseSequences();
+    
+    auto result = setModulationPatch(ModulationPatch::getDefault());
+    jassert(result.wasOk());
+    juce::ignoreUnused(result);
 }
 
 AP_Assignment2AudioProcessor::~AP_Assignment2AudioProcessor()
@@ -65,7 +127,7 @@ bool AP_Assignment2AudioProcessor::isMidiEffect() const
 
 double AP_Assignment2AudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    return reverb.getTailLengthSeconds();
 }
 
 int AP_Assignment2AudioProcessor::getNumPrograms()
@@ -97,59 +159,53 @@ void AP_Assignment2AudioProcessor::prepareToPlay (double sampleRate, int samples
 {
     // ============================== processor ====================================
     // filter
-    filter.setCoefficients(juce::IIRCoefficients::makeHighPass(sampleRate, 300.0));
-    filter.reset();
+    for (auto* bounceFilter : { &leftBounceFilter, &rightBounceFilter })
+    {
+        bounceFilter->setSampleRate(sampleRate);
+        bounceFilter->setType(StateVariableFilter::Type::HighPass);
+        bounceFilter->setCutOff(300.0f);
+    }
     sr = sampleRate;
+    profiler.setSampleRate(sampleRate);
+    governor.prepare(sampleRate, numQualityLevels - 1);
     
-    // reverb
-    juce::Reverb::Parameters reverbParams;
-    reverbParams.dryLevel = 0.5f;
-    reverbParams.wetLevel = 0.05f;
-    reverbParams.roomSize = 0.9f;
-    reverb.setParameters(reverbParams);
-    reverb.reset();
-    
-    // movement(amplitude control)
-    movement.setSampleRate(sampleRate);
-    movement.setFrequency(5.0);
-    movement.setVibratoFreq(1.0f);
-    
-    // fade in
+    // fade in, from the start of the piece
     smoothedVolume.reset(sampleRate, 2.0);
-    smoothedVolume.setTargetValue(1.0f); // Start fully faded in.
+    for (auto& level : levels)
+        level.reset(sampleRate, levelRampTime);
+    embellishmentFade.reset(sampleRate, levelRampTime);
     
-    // LFOs to control parameters
-    lfo.setSampleRate(sampleRate);
-    lfo.setFrequency(0.05);
-    lfo2.setSampleRate(sampleRate);
-    lfo2.setFrequency(0.1);
-    volLfo.setSampleRate(sampleRate);
-    volLfo.setFrequency(1.0);
+    // the spans and layer buffers of a block
+    blockCapacity = juce::jmax(1, samplesPerBlock);
+    spans.resize((size_t) blockCapacity);
+    modulationBuffer.setSize(ModulationEngine::numTargets, blockCapacity);
+    for (auto* buffer : { &padChordsBuffer, &bounceLeftBuffer, &bounceRightBuffer, &embellishmentLeftBuffer,
+                          &embellishmentRightBuffer, &stringsBuffer, &subbassBuffer })
+        buffer->resize((size_t) blockCapacity);
+    
+    // scratch buffer for the pre-roll of seekTo(), and no jump of the host's transport under way
+    seekBuffer.setSize(2, samplesPerBlock);
+    transportJump = TransportJump::none;
+    transportFade.reset(sampleRate, transportFadeTime);
+    transportFade.setCurrentAndTargetValue(1.0f);
     
     // ============================== timbre ====================================
     
     // StringSynth
     string.setSampleRate(sampleRate);
     string.setFrequency(294);
-    string.setVibratoFreq(5.0f);
     
     stringOctaveUp.setSampleRate(sampleRate);
     stringOctaveUp.setFrequency(294);
-    stringOctaveUp.setVibratoFreq(5.0f);
     
     stringRootNote.setSampleRate(sampleRate);
     stringRootNote.setFrequency(294);
     stringRootNote.setVibratoFreq(0.0f);
     
     // PadSynth
-    // 1. Pad chords (vector)
-    int oscCount = 4;
-    padChords.clear();
-    for (int i = 0; i < oscCount; i++)
-    {
-        padChords.push_back(PadSynth());
-        padChords[i].setSampleRate(sampleRate);
-    }
+    // 1. Pad chords (SIMD bank)
+    padChords.setSampleRate(sampleRate);
+    midiChords.setSampleRate(sampleRate);
     
     // 2. Bounce
     leftBounce.setSampleRate(sampleRate);
@@ -166,82 +222,559 @@ void AP_Assignment2AudioProcessor::prepareToPlay (double sampleRate, int samples
     pad.setLFOFrequency(0.0f);
     
     // Subbass
-    subbass.setSampleRate(sampleRate);
-    subbass.setFrequency(82.41);
-    subbass.setVibratoFreq(1.0f);
+    prepareSubbass();
     
-    // =========================== FrequencySelector ===========================
-    // chordsFrequencySelector
-   
-    // Determine the number of FrequencySelector
-    int selectorCount = 4;
-    chordsFreqSelector.clear();
-    for (int i = 0; i < selectorCount; i++)
+    // oscillator phases
+    auto isFixedPoint = fixedPointPhase.load();
+    for (auto* voice : { &string, &stringOctaveUp, &stringRootNote })
+        voice->setFixedPointPhase(isFixedPoint);
+    for (auto* voice : { &leftBounce, &rightBounce, &pad })
+        voice->setFixedPointPhase(isFixedPoint);
+    padChords.setFixedPointPhase(isFixedPoint);
+    midiChords.setFixedPointPhase(isFixedPoint);
+    subbass.setFixedPointPhase(isFixedPoint);
+    modulation.setFixedPointPhase(isFixedPoint);
+    
+    // Everything the parameters set, including the reverb
+    for (int i = 0; i < numParameters; i++)
     {
-        chordsFreqSelector.push_back(FrequencySelector());
+        lastHostParameters[i] = getParameterValue(Parameter (i));
+        setParameterValue(Parameter (i), lastHostParameters[i]);
     }
     
-    // Initialize a vector to hold the parameters for each chord's FrequencySelector.
-    int paramsCount = 4;
-    std::vector<FrequencySelector::Parameters> chordsFreqParams(paramsCount);
+    // Start at full quality
+    applyQualityLevel(fullQuality);
     
-    // Configure common parameters for all chords
-    for (int i = 0; i < 4; i++)
+    // reverb, and the latency it adds when it runs on its own thread
+    reverb.prepare(sampleRate, samplesPerBlock, pipelinedReverb.load());
+    setLatencySamples(reverb.getLatencySamples());
+    
+    // Worker threads for the layers, when parallel rendering is on, scheduled for blocks of this size
+    workerPool.start(numWorkerThreads.load(), samplesPerBlock, sampleRate);
+    
+    // =========================== FrequencySelector ===========================
+    // Apply the sequences at the new sample rate, picking up any that were replaced in the meantime
+    pullPendingSequences();
+    for (int i = 0; i < numSequences; i++)
+        sequences[i].sampleRate = sampleRate;
+    
+    // The layers of the score, including one loaded in the meantime
+    if (pendingScoreLayers.pull(scoreLayers))
+        playingScoreSerial = scoreLayers.serial;
+    for (int i = 0; i < numSequences; i++)
+        getFrequencySelector(Sequence (i)).setScoreLayer(scoreLayers.layers[(size_t) i]);
+    
+    // The modulation patch, including one set in the meantime
+    pendingModulationSchedule.pull(modulationSchedule);
+    modulation.setSchedule(modulationSchedule);
+    
+    // Start the piece from its first sample
+    restartTimeline();
+}
+
+void AP_Assignment2AudioProcessor::restartTimeline()
+{
+    // LFOs and movement to control parameters
+    modulation.prepare(sr, controlInterval.load());
+    
+    // Every selector restarts its generator from the seed, on its own stream, so renders are reproducible
+    appliedSeed = randomSeed.load();
+    for (int i = 0; i < numSequences; i++)
     {
-        chordsFreqParams[i].sampleRate = sampleRate;
-        chordsFreqParams[i].holdDuration = 6.4f;
-        chordsFreqParams[i].mode = FrequencySelector::SelectionMode::Sequential; // Use sequential mode
+        getFrequencySelector(Sequence (i)).setSeed(appliedSeed, (juce::uint64) i);
+        getFrequencySelector(Sequence (i)).setParameters(sequences[i]);
     }
     
-    // Set the specific frequencies for each chord
-    // Fmaj7 (F4, A4, C4, E4) - Dm7 (D4, F4, A4, C4) - Am7 (A3, C4, E4, G4) - Em7 (E4, G4, B3, D4)
-    chordsFreqParams[0].frequencies = {349.23, 293.66, 220.00, 329.63}; // Root notes
-    chordsFreqParams[1].frequencies = {440.00, 349.23, 261.63, 392.00}; // Thirds
-    chordsFreqParams[2].frequencies = {261.63, 440.00, 329.63, 246.94}; // Fifths
-    chordsFreqParams[3].frequencies = {329.63, 261.63, 392.00, 293.66}; // Sevenths
+    // Voices and filters start from silence, and the mix fades in
+    for (auto* voice : { &string, &stringOctaveUp, &stringRootNote })
+        voice->reset();
+    for (auto* voice : { &leftBounce, &rightBounce, &pad })
+        voice->reset();
+    padChords.reset();
+    midiChords.allNotesOff();
+    isPlayingMidiChords = false;
+    leftBounceFilter.reset();
+    rightBounceFilter.reset();
     
-    // Apply the configured parameters to each corresponding FrequencySelector
-    for (int i = 0; i < 4; i++)
+    subbass.reset();
+    subbassUpsampler.reset();
+    subbassPhase = 0;
+    
+    smoothedVolume.setCurrentAndTargetValue(0.0f);
+    smoothedVolume.setTargetValue(1.0f);
+    applyControlsToLayers();
+    for (auto& level : levels)
+        level.setCurrentAndTargetValue(level.getTargetValue());
+    embellishmentFade.setCurrentAndTargetValue(embellishmentFade.getTargetValue());
+    
+    timelinePosition = 0;
+}
+
+void AP_Assignment2AudioProcessor::seekTo (juce::int64 position)
+{
+    position = juce::jmax((juce::int64) 0, position);
+    auto preRoll = juce::jmin(position, (juce::int64) (seekPreRoll.load() * sr));
+    
+    // MIDI notes are not part of the piece, so they are released here
+    midiChords.releaseAllVoices();
+    
+    // Jump to the start of the pre-roll, from here when it lies ahead, otherwise from the start of the piece
+    auto preRollStart = position - preRoll;
+    if (preRollStart < timelinePosition)
+        restartTimeline();
+    skipTimeline(preRollStart - timelinePosition, std::numeric_limits<int>::max(), true);
+    reverb.setModulationPosition(preRollStart);
+    
+    // Render the pre-roll and drop it; the voices come out of the skip with their filters at rest
+    juce::MidiBuffer noMidi;
+    while (timelinePosition < position)
+    {
+        auto numSamples = (int) juce::jmin((juce::int64) seekBuffer.getNumSamples(), position - timelinePosition);
+        renderBlock(seekBuffer.getWritePointer(0), seekBuffer.getWritePointer(1), numSamples, noMidi);
+    }
+    
+    // The released notes have faded into the dropped pre-roll; from here the piece plays its own chords again
+    midiChords.allNotesOff();
+    isPlayingMidiChords = false;
+}
+
+juce::int64 AP_Assignment2AudioProcessor::skipTimeline (juce::int64 numSamples, int maxNotes, bool isExact)
+{
+    // The voices, ramps and note counters move over a whole note at once, in closed form. Voices that no LFO reaches
+    // need nothing else; the others follow the LFOs either over each control interval, or over the whole note at their
+    // mean rate, with the LFOs ending on the values they take at the last control interval in it.
+    juce::int64 numSkipped = 0;
+    for (int note = 0; note < maxNotes && numSkipped < numSamples; note++)
     {
-        chordsFreqSelector[i].setParameters(chordsFreqParams[i]);
+        updateNoteControls();
+        applyControlsToLayers();
+        auto noteLength = (int) juce::jmin(numSamples - numSkipped, (juce::int64) getNumSamplesToNextNoteChange());
+        
+        for (auto* voice : { &string, &stringOctaveUp, &stringRootNote })
+            voice->skip(noteLength);
+        pad.skip(noteLength);
+        
+        if (isExact)
+        {
+            for (int remaining = noteLength; remaining > 0;)
+            {
+                if (modulation.updateIfDue())
+                {
+                    updateModulationControls();
+                    applyControlsToLayers();
+                }
+                
+                auto spanLength = juce::jmin(remaining, modulation.getNumSamplesToNextUpdate());
+                skipSpan(spanLength);
+                modulation.skip(spanLength);
+                remaining -= spanLength;
+            }
+        }
+        else
+        {
+            std::array<float, ModulationEngine::numTargets> averages;
+            modulation.skipUpdates(noteLength, averages);
+            padChords.setLFOFrequency(averages[ModulationEngine::padLFOFrequency]);
+            leftBounce.setLFOFrequency(averages[ModulationEngine::bounceLFOFrequency]);
+            rightBounce.setLFOFrequency(averages[ModulationEngine::bounceLFOFrequency]);
+            subbass.setDetuneFine(int (averages[ModulationEngine::subDetuneFine]));
+            skipSpan(noteLength);
+            updateModulationControls();
+            applyControlsToLayers();
+        }
+        
+        for (int i = 0; i < numSequences; i++)
+            getFrequencySelector(Sequence (i)).advance(noteLength);
+        
+        numSkipped += noteLength;
+        timelinePosition += noteLength;
     }
+    return numSkipped;
+}
+
+void AP_Assignment2AudioProcessor::skipSpan (int numSamples)
+{
+    // The pad chords and bounce run at the LFO rates they were given for the span
+    padChords.skip(numSamples);
+    leftBounce.skip(numSamples);
+    rightBounce.skip(numSamples);
+    
+    // The subbass renders a sample wherever subbassPhase is 0
+    auto factor = subbassUpsampler.getFactor();
+    auto firstSubbassSample = (factor - subbassPhase) % factor;
+    subbass.skip((numSamples - firstSubbassSample + factor - 1) / factor);
+    subbassPhase = (subbassPhase + numSamples) % factor;
+    
+    // The mix reads the volume once for each channel, and each layer reads its level once
+    smoothedVolume.skip(2 * numSamples);
+    for (auto& level : levels)
+        level.skip(numSamples);
+    embellishmentFade.skip(numSamples);
+}
+
+void AP_Assignment2AudioProcessor::applyQualityLevel (int level)
+{
+    // Each level keeps the savings of the ones before it
+    qualityLevel = level;
+    midiChords.setNumVoicesInUse(level >= fewerPadVoices ? VoiceManager::maxVoices / 2 : VoiceManager::maxVoices);
+    reverb.setTapModulation(level < cheapReverb);
+    embellishmentFade.setTargetValue(level >= noEmbellishment ? 0.0f : 1.0f);
+}
+
+void AP_Assignment2AudioProcessor::initialiseSequences()
+{
+    // The hold durations are set by the parameters
+    // chordsFrequencySelector
+    // Configure common parameters for all chords
+    for (int i = chordRoots; i <= chordSevenths; i++)
+        sequences[i].mode = FrequencySelector::SelectionMode::Sequential; // Use sequential mode
+    
+    // Set the specific frequencies for each chord
+    // Fmaj7 (F4, A4, C4, E4) - Dm7 (D4, F4, A4, C4) - Am7 (A3, C4, E4, G4) - Em7 (E4, G4, B3, D4)
+    sequences[chordRoots].setFrequencies({349.23, 293.66, 220.00, 329.63});    // Root notes
+    sequences[chordThirds].setFrequencies({440.00, 349.23, 261.63, 392.00});   // Thirds
+    sequences[chordFifths].setFrequencies({261.63, 440.00, 329.63, 246.94});   // Fifths
+    sequences[chordSevenths].setFrequencies({329.63, 261.63, 392.00, 293.66}); // Sevenths
     
     
     // bounceFrequencySelector
-    FrequencySelector::Parameters leftbounceFreqParams;
-    leftbounceFreqParams.sampleRate = sampleRate;
-    leftbounceFreqParams.frequencies = {261.63, 329.63, 392.00, 0.00, 0.00}; // 0 is used to create an interval
-    leftbounceFreqParams.holdDuration = 6.4f;
-    leftbounceFreqSelector.setParameters(leftbounceFreqParams); // Default random mode
-  
-    FrequencySelector::Parameters rightbounceFreqParams;
-    rightbounceFreqParams.sampleRate = sampleRate;
-    rightbounceFreqParams.frequencies = {261.63, 329.63, 392.00, 0.00, 0.00}; // 0 is used to create an interval
-    rightbounceFreqParams.holdDuration = 3.2f;
-    rightbounceFreqSelector.setParameters(rightbounceFreqParams); // Default random mode
+    sequences[leftBounceNotes].setFrequencies({261.63, 329.63, 392.00, 0.00, 0.00}); // 0 is used to create an interval
+    // Default random mode
+    
+    sequences[rightBounceNotes].setFrequencies({261.63, 329.63, 392.00, 0.00, 0.00}); // 0 is used to create an interval
+    // Default random mode
     
     
     // stringFrequencySelector
-    FrequencySelector::Parameters stringFreqParams;
-    stringFreqParams.sampleRate = sampleRate;
-    stringFreqParams.frequencies = {261.63, 261.63, 261.63, 0.00, 392.00, 349.23, 329.63, 0.00}; // 0 is used to create an interval
-    stringFreqParams.holdDuration = 0.8f;
-    stringFreqParams.mode = FrequencySelector::SelectionMode::Sequential; // Use sequential mode
-    stringFreqSelector.setParameters(stringFreqParams);
+    sequences[stringMotif].setFrequencies({261.63, 261.63, 261.63, 0.00, 392.00, 349.23, 329.63, 0.00}); // 0 is used to create an interval
+    sequences[stringMotif].mode = FrequencySelector::SelectionMode::Sequential; // Use sequential mode
     
     
     // padFrequencySelector
-    FrequencySelector::Parameters padFreqParams;
-    padFreqParams.sampleRate = sampleRate;
-    padFreqParams.frequencies = {1046.52, 1568, 0.00, 0.00, 0.00, 0.00, 0.00}; // 0 is used to create an interval
-    padFreqParams.holdDuration = 0.4f;
-    padFreqSelector.setParameters(padFreqParams); // Default random mode
+    sequences[padEmbellishment].setFrequencies({1046.52, 1568, 0.00, 0.00, 0.00, 0.00, 0.00}); // 0 is used to create an interval
+    // Default random mode
+}
+
+FrequencySelector& AP_Assignment2AudioProcessor::getFrequencySelector (Sequence sequence)
+{
+    switch (sequence)
+    {
+        case leftBounceNotes:  return leftbounceFreqSelector;
+        case rightBounceNotes: return rightbounceFreqSelector;
+        case stringMotif:      return stringFreqSelector;
+        case padEmbellishment: return padFreqSelector;
+        default:               return chordsFreqSelector[sequence - chordRoots];
+    }
+}
+
+int AP_Assignment2AudioProcessor::getNumSamplesToNextNoteChange()
+{
+    int numSamples = std::numeric_limits<int>::max();
+    for (int i = 0; i < numSequences; i++)
+        numSamples = juce::jmin(numSamples, getFrequencySelector(Sequence (i)).getNumSamplesToNextChange());
+    return numSamples;
+}
+
+void AP_Assignment2AudioProcessor::setSequence (Sequence sequence, const FrequencySelector::Parameters& newParameters)
+{
+    // a count beyond the list would read past it once the audio thread selects from it
+    jassert(newParameters.numFrequencies >= 0 && newParameters.numFrequencies <= FrequencySelector::maxFrequencies);
+    auto parameters = newParameters;
+    parameters.numFrequencies = juce::jlimit(0, FrequencySelector::maxFrequencies, parameters.numFrequencies);
+    pendingSequences[sequence].push(parameters);
+}
+
+const char* AP_Assignment2AudioProcessor::getSequenceName (Sequence sequence)
+{
+    switch (sequence)
+    {
+        case chordRoots:        return "chordRoots";
+        case chordThirds:       return "chordThirds";
+        case chordFifths:       return "chordFifths";
+        case chordSevenths:     return "chordSevenths";
+        case leftBounceNotes:   return "leftBounceNotes";
+        case rightBounceNotes:  return "rightBounceNotes";
+        case stringMotif:       return "stringMotif";
+        case padEmbellishment:  return "padEmbellishment";
+        default:                return "";
+    }
+}
+
+juce::Result AP_Assignment2AudioProcessor::loadScore (const juce::File& file)
+{
+    // Mapped, checked and looked up here, so the audio thread only copies the layers
+    std::unique_ptr<Score> newScore;
+    ScoreLayers newLayers;
+    if (file != juce::File())
+    {
+        newScore = std::make_unique<Score>();
+        auto result = newScore->load(file);
+        if (result.failed())
+            return result;
+        
+        for (int i = 0; i < numSequences; i++)
+            newLayers.layers[(size_t) i] = newScore->getLayer(getSequenceName(Sequence (i)));
+    }
+    
+    const juce::ScopedLock lock (scoreLock);
+    newLayers.serial = ++lastScoreSerial;
+    if (newScore != nullptr)
+        loadedScores.push_back({ newLayers.serial, std::move(newScore) });
+    pendingScoreLayers.push(newLayers);
+    scoreFile = file;
+    
+    // Unmap the scores the audio thread has moved past
+    auto playingSerial = playingScoreSerial.load();
+    auto firstInUse = std::find_if(loadedScores.begin(), loadedScores.end(),
+                                   [playingSerial] (const LoadedScore& loaded) { return loaded.serial >= playingSerial; });
+    loadedScores.erase(loadedScores.begin(), firstInUse);
+    return juce::Result::ok();
+}
+
+juce::Result AP_Assignment2AudioProcessor::setModulationPatch (const juce::String& json)
+{
+    // Compiled here, so the audio thread only copies the schedule
+    ModulationEngine::Schedule schedule;
+    auto result = ModulationPatch::compile(json, schedule);
+    if (result.failed())
+        return result;
+    
+    modulationPatch = json;
+    pendingModulationSchedule.push(schedule);
+    return result;
+}
+
+juce::String AP_Assignment2AudioProcessor::getModulationPatch() const
+{
+    return modulationPatch;
+}
+
+void AP_Assignment2AudioProcessor::pullPendingSequences()
+{
+    for (int i = 0; i < numSequences; i++)
+    {
+        if (pendingSequences[i].pull(sequences[i]))
+        {
+            sequences[i].sampleRate = sr;
+            sequences[i].holdDuration = currentParameters[getHoldParameter(Sequence (i))];
+            getFrequencySelector(Sequence (i)).setParameters(sequences[i]);
+        }
+    }
+}
+
+juce::AudioProcessorValueTreeState::ParameterLayout AP_Assignment2AudioProcessor::createParameterLayout()
+{
+    juce::AudioProcessorValueTreeState::ParameterLayout layout;
+    for (auto& info : parameterInfo)
+    {
+        juce::NormalisableRange<float> range (info.minimum, info.maximum);
+        if (info.skewCentre > 0.0f)
+            range.setSkewForCentre(info.skewCentre);
+        
+        layout.add(std::make_unique<juce::AudioParameterFloat> (juce::ParameterID { info.id, 1 }, info.name, range, info.defaultValue));
+    }
+    return layout;
+}
+
+juce::AudioProcessorValueTreeState& AP_Assignment2AudioProcessor::getValueTreeState()
+{
+    return parameters;
+}
+
+float AP_Assignment2AudioProcessor::getParameterValue (Parameter parameter) const
+{
+    return parameterValues[parameter]->load(std::memory_order_relaxed);
+}
+
+AP_Assignment2AudioProcessor::Parameter AP_Assignment2AudioProcessor::getHoldParameter (Sequence sequence)
+{
+    switch (sequence)
+    {
+        case leftBounceNotes:  return leftBounceHold;
+        case rightBounceNotes: return rightBounceHold;
+        case stringMotif:      return stringHold;
+        case padEmbellishment: return embellishmentHold;
+        default:               return chordsHold;
+    }
+}
+
+void AP_Assignment2AudioProcessor::setParameterValue (Parameter parameter, float value)
+{
+    currentParameters[parameter] = value;
+    
+    switch (parameter)
+    {
+        // Levels ramp to their new values
+        case padChordsLevel:
+        case bounceLevel:
+        case embellishmentLevel:
+        case stringOctaveUpLevel:
+        case subbassLevel:
+            layerControls.levels[parameter] = value;
+            layerControls.hasNewParameters = true;
+            break;
+        
+        case reverbRoomSize:
+        case reverbDamping:
+        case reverbWetLevel:
+        case reverbDryLevel:
+        case reverbWidth:
+        {
+            auto reverbParams = reverb.getParameters();
+            reverbParams.roomSize = currentParameters[reverbRoomSize];
+            reverbParams.damping = currentParameters[reverbDamping];
+            reverbParams.wetLevel = currentParameters[reverbWetLevel];
+            reverbParams.dryLevel = currentParameters[reverbDryLevel];
+            reverbParams.width = currentParameters[reverbWidth];
+            reverb.setParameters(reverbParams);
+            break;
+        }
+        
+        // Hold durations; the selectors keep their place in the notes they are holding
+        case chordsHold:
+        case leftBounceHold:
+        case rightBounceHold:
+        case stringHold:
+        case embellishmentHold:
+            for (int i = 0; i < numSequences; i++)
+            {
+                if (getHoldParameter(Sequence (i)) == parameter && sequences[i].holdDuration != value)
+                {
+                    sequences[i].holdDuration = value;
+                    getFrequencySelector(Sequence (i)).setHoldDuration(value);
+                }
+            }
+            break;
+        
+        // Modulation rates and cutoff ranges; the sources keep their phases, and the filters follow new ranges at once
+        case lfoRate:
+        case lfo2Rate:
+        case panRate:
+        case movementRate:
+        case padCutoffMin:
+        case padCutoffMax:
+        case bounceCutoffMin:
+        case bounceCutoffMax:
+        {
+            ModulationEngine::Settings settings;
+            settings.lfoRate = currentParameters[lfoRate];
+            settings.lfo2Rate = currentParameters[lfo2Rate];
+            settings.panRate = currentParameters[panRate];
+            settings.movementRate = currentParameters[movementRate];
+            settings.padCutoffMin = currentParameters[padCutoffMin];
+            settings.padCutoffMax = currentParameters[padCutoffMax];
+            settings.bounceCutoffMin = currentParameters[bounceCutoffMin];
+            settings.bounceCutoffMax = currentParameters[bounceCutoffMax];
+            modulation.setSettings(settings);
+            updateModulationControls();
+            break;
+        }
+        
+        case stringVibratoRate:
+            layerControls.stringVibratoRate = value;
+            layerControls.hasNewParameters = true;
+            break;
+        
+        case bounceResonance:
+            layerControls.bounceResonance = value;
+            layerControls.hasNewParameters = true;
+            break;
+        
+        default:
+            break;
+    }
+}
+
+void AP_Assignment2AudioProcessor::pullHostParameters()
+{
+    for (int i = 0; i < numParameters; i++)
+    {
+        auto value = getParameterValue(Parameter (i));
+        if (value != lastHostParameters[i])
+        {
+            lastHostParameters[i] = value;
+            setParameterValue(Parameter (i), value);
+        }
+    }
+}
+
+bool AP_Assignment2AudioProcessor::scheduleParameterChange (Parameter parameter, float value, juce::int64 position)
+{
+    int start1, size1, start2, size2;
+    parameterEventFifo.prepareToWrite(1, start1, size1, start2, size2);
+    if (size1 == 0)
+        return false;
+    
+    auto& info = parameterInfo[parameter];
+    parameterEventQueue[(size_t) start1] = { position, parameter, juce::jlimit(info.minimum, info.maximum, value) };
+    parameterEventFifo.finishedWrite(1);
+    return true;
+}
+
+void AP_Assignment2AudioProcessor::pullParameterEvents()
+{
+    int start1, size1, start2, size2;
+    parameterEventFifo.prepareToRead(maxParameterEvents - numPendingParameterEvents, start1, size1, start2, size2);
+    
+    // Insert each event after those at the same position, so they apply in the order they were scheduled
+    auto insert = [this] (int start, int size)
+    {
+        for (int i = start; i < start + size; i++)
+        {
+            auto& event = parameterEventQueue[(size_t) i];
+            auto j = numPendingParameterEvents++;
+            for (; j > 0 && pendingParameterEvents[(size_t) j - 1].position > event.position; j--)
+                pendingParameterEvents[(size_t) j] = pendingParameterEvents[(size_t) j - 1];
+            pendingParameterEvents[(size_t) j] = event;
+        }
+    };
+    insert(start1, size1);
+    insert(start2, size2);
+    parameterEventFifo.finishedRead(size1 + size2);
+}
+
+void AP_Assignment2AudioProcessor::applyParameterEvents (juce::int64 position)
+{
+    int numApplied = 0;
+    for (; numApplied < numPendingParameterEvents && pendingParameterEvents[(size_t) numApplied].position <= position; numApplied++)
+        setParameterValue(pendingParameterEvents[(size_t) numApplied].parameter, pendingParameterEvents[(size_t) numApplied].value);
+    
+    if (numApplied > 0)
+    {
+        std::copy(pendingParameterEvents.begin() + numApplied, pendingParameterEvents.begin() + numPendingParameterEvents, pendingParameterEvents.begin());
+        numPendingParameterEvents -= numApplied;
+    }
+}
+
+void AP_Assignment2AudioProcessor::setControllerParameter (int controller, Parameter parameter)
+{
+    if (juce::isPositiveAndBelow(controller, (int) controllerParameters.size()))
+        controllerParameters[(size_t) controller] = parameter;
+}
+
+AP_Assignment2AudioProcessor::Parameter AP_Assignment2AudioProcessor::getControllerParameter (const juce::MidiMessage& message) const
+{
+    if (! message.isController())
+        return numParameters;
+    
+    return Parameter (controllerParameters[(size_t) message.getControllerNumber()].load());
+}
+
+bool AP_Assignment2AudioProcessor::isNoteMessage (const juce::MidiMessage& message)
+{
+    return message.isNoteOnOrOff() || message.isAllNotesOff() || message.isAllSoundOff();
+}
+
+void AP_Assignment2AudioProcessor::setMinimumSubBlockSize (int numSamples)
+{
+    minimumSubBlockSize = juce::jmax(1, numSamples);
 }
 
 void AP_Assignment2AudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+    reverb.stop();
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -279,124 +812,645 @@ void AP_Assignment2AudioProcessor::processBlock (juce::AudioBuffer<float>& buffe
     float* leftChannel = buffer.getWritePointer(0); // left channel
     float* rightChannel = buffer.getWritePointer(1); // right channel
     
-    // DSP loop
-    for(int i = 0; i < numSamples; i++)
+    profiler.beginBlock();
+    governor.beginBlock();
+    
+    // Render at the quality the governor chose from the previous blocks; offline renders have no deadline
+    auto level = isNonRealtime() ? (int) fullQuality : governor.getLevel();
+    if (level != qualityLevel)
+        applyQualityLevel(level);
+    
+    // Pick up parameter, sequence, patch, score and control interval changes requested from other threads
+    pullHostParameters();
+    pullParameterEvents();
+    pullPendingSequences();
+    if (pendingModulationSchedule.pull(modulationSchedule))
+        modulation.setSchedule(modulationSchedule);
+    if (pendingScoreLayers.pull(scoreLayers))
     {
-        // === Amplitude Control ===
-        // Modulate the amplitude of a signal using the instance from "movement" class
-        float vibratoAmount = (lfo.process() + 1.0f) / 80 + 0.005; // Scale LFO output from -1~1 to 0.005~0.03
-        movement.setVibratoAmount(vibratoAmount);
-        auto movementVal = movement.process();
-        
-        // === Stereo Volume Control ===
-        // Control the volume of the left and right channels independently to create a stereo effect.
-        float leftVolume = (volLfo.process() + 1.0f) / 2; // scale it from -1-1 to 0-1
-        float rightVolume = 1 - leftVolume;
-        
+        for (int i = 0; i < numSequences; i++)
+            getFrequencySelector(Sequence (i)).changeScoreLayer(scoreLayers.layers[(size_t) i]);
+        playingScoreSerial = scoreLayers.serial;
+    }
+    
+    auto interval = controlInterval.load() * (qualityLevel >= coarseControlRate ? 2 : 1);
+    if (interval != modulation.getControlInterval())
+        modulation.setControlInterval(interval);
+    
+    if (subbassRateFactor.load() != subbassUpsampler.getFactor())
+        prepareSubbass();
+    
+    // A new seed, such as one restored with the plugin state, restarts the piece from it; following the host's
+    // transport then brings it back to where the host plays
+    if (randomSeed.load() != appliedSeed)
+        restartTimeline();
+    
+    // Follow the host's transport. The blocks of a real-time jump are silent but for the reverb tail; MIDI notes that
+    // start in them sound once the jump has arrived.
+    auto isLoadBlock = transportJump == TransportJump::none;
+    if (followHostTransport(numSamples))
+    {
+        renderBlock(leftChannel, rightChannel, numSamples, midiMessages);
+    }
+    else
+    {
+        for (auto it = midiMessages.cbegin(); it != midiMessages.cend(); ++it)
+            handleMidiEvent((*it).getMessage());
+        std::fill(leftChannel, leftChannel + numSamples, 0.0f);
+        std::fill(rightChannel, rightChannel + numSamples, 0.0f);
+        reverb.processStereo(leftChannel, rightChannel, numSamples, false);
+    }
+    profiler.endBlock(numSamples);
+    
+    // A jump does other work than rendering the block, so its time says nothing about the load
+    governor.endBlock(numSamples, ! isNonRealtime() && isLoadBlock && transportJump == TransportJump::none);
+}
+
+bool AP_Assignment2AudioProcessor::followHostTransport (int numSamples)
+{
+    // Where the host plays this block from, or -1 when it is stopped or does not say
+    juce::int64 hostPosition = -1;
+    if (auto* playHead = getPlayHead())
+    {
+        auto position = playHead->getPosition();
+        if (position.hasValue() && position->getIsPlaying())
+        {
+            auto time = position->getTimeInSamples();
+            if (time.hasValue() && *time >= 0)
+                hostPosition = *time;
+        }
+    }
+    
+    // Offline renders have no deadline, so they jump at once, pre-roll included, and finish a real-time jump that way
+    if (isNonRealtime())
+    {
+        if (transportJump != TransportJump::none)
+        {
+            transportJump = TransportJump::none;
+            transportFade.setCurrentAndTargetValue(1.0f);
+            if (hostPosition < 0)
+                hostPosition = jumpTarget;
+        }
+        if (hostPosition >= 0 && hostPosition != timelinePosition)
+            seekTo(hostPosition);
+        return true;
+    }
+    
+    switch (transportJump)
+    {
+        case TransportJump::none:
+        {
+            if (hostPosition < 0 || hostPosition == timelinePosition)
+                return true;
+            
+            // This block still plays on from here, with the MIDI notes released and the dry mix fading out
+            midiChords.releaseAllVoices();
+            auto gain = transportFade.getCurrentValue();
+            transportFade.reset(numSamples);
+            transportFade.setCurrentAndTargetValue(gain);
+            transportFade.setTargetValue(0.0f);
+            transportJump = TransportJump::fadingOut;
+            jumpTarget = hostPosition + numSamples;
+            return true;
+        }
         
-        // === Pad Synthesis ===
-        // 1. Pad chords (vector)
-        float outputValue = 0.0; // Initialize the output value
+        case TransportJump::fadingOut:
+        {
+            // The dry mix is silent now, so the released MIDI notes can stop
+            midiChords.allNotesOff();
+            isPlayingMidiChords = false;
+            transportJump = TransportJump::skipping;
+            break;
+        }
         
-        // Set frequencies for each pad oscillator, selected by chord frequency selectors.
-        float firstFrequency = chordsFreqSelector[0].process();
-        padChords[0].setFrequency(firstFrequency);
-        float secondFrequency = chordsFreqSelector[1].process();
-        padChords[1].setFrequency(secondFrequency);
-        float thirdFrequency = chordsFreqSelector[2].process();
-        padChords[2].setFrequency(thirdFrequency);
-        float fourthFrequency = chordsFreqSelector[3].process();
-        padChords[3].setFrequency(fourthFrequency);
+        case TransportJump::skipping:
+        default:
+            break;
+    }
+    
+    // Skip towards where the host plays now, from the start of the piece when that lies behind
+    auto target = hostPosition >= 0 ? hostPosition : jumpTarget;
+    if (target < timelinePosition)
+        restartTimeline();
+    skipTimeline(target - timelinePosition, juce::jmax(1, numSamples / samplesPerSkippedNote), false);
+    if (timelinePosition < target)
+    {
+        jumpTarget = target + numSamples;
+        return false;
+    }
+    
+    // Arrived: the reverb modulation moves where a continuous render would have it, and the dry mix fades back in
+    reverb.setModulationPosition(timelinePosition);
+    transportFade.reset(sr, transportFadeTime);
+    transportFade.setCurrentAndTargetValue(0.0f);
+    transportFade.setTargetValue(1.0f);
+    transportJump = TransportJump::none;
+    return true;
+}
+
+void AP_Assignment2AudioProcessor::renderBlock (float* leftChannel, float* rightChannel, int numSamples, const juce::MidiBuffer& midiMessages)
+{
+    // DSP loop, split into spans that end where the LFOs are evaluated next, at the next note change, at the next MIDI
+    // note message or at the next parameter change. Within a span all parameters are constant. Parameter changes less
+    // than minimumSpan after its start wait for its end, so dense automation cannot make the spans arbitrarily short.
+    // Other MIDI messages do not end a span; they are handled at the start of the next one.
+    // All spans of the block are planned first, then every layer renders them in one go, so the worker threads are
+    // only met once per block. The MIDI voices queue the notes played over the block; a block longer than the
+    // buffers, or with more notes than the queue holds, is planned and rendered in parts.
+    auto minimumSpan = minimumSubBlockSize.load();
+    auto midiIterator = midiMessages.cbegin();
+    for (int start = 0; start < numSamples;)
+    {
+        auto partStart = start;
+        auto partEnd = juce::jmin(numSamples, start + blockCapacity);
+        numSpans = 0;
+        while (start < partEnd)
+        {
+            // With the queue full, the spans planned so far are rendered before the next message is handled
+            for (; midiIterator != midiMessages.cend() && (*midiIterator).samplePosition <= start; ++midiIterator)
+            {
+                if (numSpans > 0 && ! midiChords.hasRoomForMessage())
+                    break;
+                handleMidiEvent((*midiIterator).getMessage());
+            }
+            if (midiIterator != midiMessages.cend() && (*midiIterator).samplePosition <= start)
+                break;
+            applyParameterEvents(timelinePosition + start);
+            
+            if (modulation.updateIfDue())
+                updateModulationControls();
+            
+            int spanLength = juce::jmin(partEnd - start, modulation.getNumSamplesToNextUpdate(), maxSpanLength);
+            spanLength = juce::jmin(spanLength, getNumSamplesToNextNoteChange());
+            for (auto it = midiIterator; it != midiMessages.cend() && (*it).samplePosition - start < spanLength; ++it)
+            {
+                auto position = (*it).samplePosition - start;
+                auto message = (*it).getMessage();
+                if (isNoteMessage(message))
+                {
+                    spanLength = position;
+                    break;
+                }
+                if (getControllerParameter(message) != numParameters)
+                    spanLength = juce::jmin(spanLength, juce::jmax(position, minimumSpan));
+            }
+            if (numPendingParameterEvents > 0)
+            {
+                auto position = pendingParameterEvents[0].position - (timelinePosition + start);
+                spanLength = (int) juce::jmin((juce::int64) spanLength, juce::jmax(position, (juce::int64) minimumSpan));
+            }
+            planSpan(start - partStart, spanLength);
+            modulation.advance(spanLength);
+            for (int i = 0; i < numSequences; i++)
+                getFrequencySelector(Sequence (i)).advance(spanLength);
+            midiChords.advance(spanLength);
+            start += spanLength;
+        }
+        profiler.lap(modulationStage);
+        renderSpans(leftChannel + partStart, rightChannel + partStart, start - partStart);
+    }
+    
+    // Messages the host placed at or after the end of the block take effect from the next one
+    for (; midiIterator != midiMessages.cend(); ++midiIterator)
+        handleMidiEvent((*midiIterator).getMessage());
+    
+    // Fade the dry mix around a jump of the host's transport
+    if (transportFade.isSmoothing() || transportFade.getCurrentValue() < 1.0f)
+    {
+        for (int i = 0; i < numSamples; i++)
+        {
+            auto gain = transportFade.getNextValue();
+            leftChannel[i] *= gain;
+            rightChannel[i] *= gain;
+        }
+    }
+    
+    // Apply stereo reverb to the final mix; offline renders wait for the reverb thread rather than drop its output
+    reverb.processStereo(leftChannel, rightChannel, numSamples, isNonRealtime());
+    profiler.lap(reverbStage);
+    timelinePosition += numSamples;
+}
+
+void AP_Assignment2AudioProcessor::setControlInterval (int numSamples)
+{
+    controlInterval = juce::jmax(1, numSamples);
+}
+
+const char* AP_Assignment2AudioProcessor::getStageName (Stage stage)
+{
+    switch (stage)
+    {
+        case modulationStage:      return "Modulation";
+        case padChordsStage:       return "Pad chords";
+        case bounceStage:          return "Bounce";
+        case embellishmentStage:   return "Embellishment";
+        case stringsStage:         return "Strings";
+        case subbassStage:         return "Subbass";
+        case parallelLayersStage:  return "Layers (parallel)";
+        case mixStage:             return "Mix";
+        case reverbStage:          return "Reverb";
+        default:                 return "";
+    }
+}
+
+void AP_Assignment2AudioProcessor::setProfilingEnabled (bool shouldProfile)
+{
+    profiler.setEnabled(shouldProfile);
+}
+
+AP_Assignment2AudioProcessor::Profiler::Snapshot AP_Assignment2AudioProcessor::getProfilerSnapshot()
+{
+    return profiler.getSnapshot();
+}
+
+void AP_Assignment2AudioProcessor::setQualityGovernorEnabled (bool shouldBeEnabled)
+{
+    governor.setEnabled(shouldBeEnabled);
+}
+
+QualityGovernor::Snapshot AP_Assignment2AudioProcessor::getQualitySnapshot() const
+{
+    return governor.getSnapshot();
+}
+
+void AP_Assignment2AudioProcessor::setNumWorkerThreads (int numWorkers)
+{
+    numWorkerThreads = juce::jlimit(0, numLayers - 1, numWorkers);
+}
+
+void AP_Assignment2AudioProcessor::setReverbPipelined (bool shouldBePipelined)
+{
+    pipelinedReverb = shouldBePipelined;
+}
+
+void AP_Assignment2AudioProcessor::setFixedPointPhase (bool shouldUseFixedPoint)
+{
+    fixedPointPhase = shouldUseFixedPoint;
+}
+
+void AP_Assignment2AudioProcessor::setSeekPreRoll (double seconds)
+{
+    seekPreRoll = juce::jmax(0.0, seconds);
+}
+
+void AP_Assignment2AudioProcessor::setSubbassRateFactor (int factor)
+{
+    // Round down to a power of two the upsampler supports
+    subbassRateFactor = 1 << juce::findHighestSetBit ((juce::uint32) juce::jlimit (1, HalfBandUpsampler::maxFactor, factor));
+}
+
+void AP_Assignment2AudioProcessor::prepareSubbass()
+{
+    subbassUpsampler.setFactor(subbassRateFactor.load());
+    subbassPhase = 0;
+    
+    subbass.setSampleRate(sr / subbassUpsampler.getFactor());
+    subbass.setFrequency(82.41);
+    subbass.setVibratoFreq(1.0f);
+    subbass.setDetuneFine(int (modulation.getTargetValue(ModulationEngine::subDetuneFine)));
+}
+
+void AP_Assignment2AudioProcessor::handleMidiEvent (const juce::MidiMessage& message)
+{
+    // The first note takes the chord layer over from the built-in progression
+    if (message.isNoteOn())
+        isPlayingMidiChords = true;
+    
+    // Mapped controllers set their parameter from this sample on
+    auto parameter = getControllerParameter(message);
+    if (parameter != numParameters)
+        setParameterValue(parameter, parameterObjects[parameter]->convertFrom0to1(message.getControllerValue() / 127.0f));
+    
+    midiChords.handleMidiMessage(message);
+}
+
+void AP_Assignment2AudioProcessor::updateModulationControls()
+{
+    // Pad chords: filter and LFO, for the built-in and the MIDI chords alike
+    layerControls.padCutoff = modulation.getTargetValue(ModulationEngine::padCutoff);
+    layerControls.padLFOFrequency = modulation.getTargetValue(ModulationEngine::padLFOFrequency);
+    layerControls.padLFOAmount = modulation.getTargetValue(ModulationEngine::padLFOAmount);
+    
+    // Bounce: moving high pass filter to reduce low frequency, and dynamic timbre change
+    layerControls.bounceCutoff = modulation.getTargetValue(ModulationEngine::bounceCutoff);
+    layerControls.bounceLFOFrequency = modulation.getTargetValue(ModulationEngine::bounceLFOFrequency);
+    
+    // Subbass: detune recomputes the detuned oscillator frequencies, so it only follows the control rate
+    layerControls.subDetuneFine = int (modulation.getTargetValue(ModulationEngine::subDetuneFine));
+    layerControls.hasNewModulation = true;
+}
+
+void AP_Assignment2AudioProcessor::updateNoteControls()
+{
+    // Spans end at every note change, so the notes hold for the whole span.
+    // 1. Chord progression, on the pad chords. The chords also give the root note for the strings;
+    //    once MIDI notes arrive, the lowest held note is the root instead.
+    for (size_t j = 0; j < chordsFreqSelector.size(); j++)
+        layerControls.chordFrequencies[j] = chordsFreqSelector[j].getCurrentFrequency();
+    
+    layerControls.isPlayingMidiChords = isPlayingMidiChords;
+    auto rootFrequency = layerControls.chordFrequencies[0];
+    if (isPlayingMidiChords)
+        rootFrequency = midiChords.getLowestFrequency(rootFrequency);
+    
+    // 2. Bounce and pad embellishment
+    layerControls.leftBounceFrequency = leftbounceFreqSelector.getCurrentFrequency();
+    layerControls.rightBounceFrequency = rightbounceFreqSelector.getCurrentFrequency();
+    layerControls.padFrequency = padFreqSelector.getCurrentFrequency();
+    
+    // 3. Strings
+    layerControls.stringRootFrequency = rootFrequency / 2;     // add string to emphasize the root note
+    layerControls.stringFrequency = stringFreqSelector.getCurrentFrequency(); // select notes
+}
+
+void AP_Assignment2AudioProcessor::applyLayerControls (Layer layer, const LayerControls& controls)
+{
+    switch (layer)
+    {
+        case padChordsLayer:
+        {
+            for (int j = 0; j < padChords.getNumVoices(); j++)
+                padChords.setFrequency(j, controls.chordFrequencies[(size_t) j]);
+            
+            if (controls.hasNewModulation)
+            {
+                padChords.setFilterCutOff(controls.padCutoff);
+                padChords.setLFOFrequency(controls.padLFOFrequency);
+                padChords.setLFOAmount(controls.padLFOAmount);
+                midiChords.setFilterCutOff(controls.padCutoff);
+                midiChords.setLFOFrequency(controls.padLFOFrequency);
+                midiChords.setLFOAmount(controls.padLFOAmount);
+            }
+            if (controls.hasNewParameters)
+                levels[padChordsLevel].setTargetValue(controls.levels[padChordsLevel]);
+            break;
+        }
         
-        // Set dynamic parameters for Pad chords
-        float filterCutoffVal = lfo.process() * 4000 + 5000;
-        float LFOFreq = (lfo.process() + 1.0f) * 3 + 0.1; // scale it from -1-1 to 0.1-6
-        float LFOAmount = (lfo.process() + 1.0f) / 8; // scale it from -1-1 to 0.0-0.25
+        case bounceLayer:
+        {
+            leftBounce.setFrequency(controls.leftBounceFrequency);
+            rightBounce.setFrequency(controls.rightBounceFrequency);
+            
+            if (controls.hasNewModulation)
+            {
+                leftBounceFilter.setCutOff(controls.bounceCutoff);
+                rightBounceFilter.setCutOff(controls.bounceCutoff);
+                leftBounce.setLFOFrequency(controls.bounceLFOFrequency);
+                rightBounce.setLFOFrequency(controls.bounceLFOFrequency);
+            }
+            if (controls.hasNewParameters)
+            {
+                levels[bounceLevel].setTargetValue(controls.levels[bounceLevel]);
+                leftBounceFilter.setResonance(controls.bounceResonance);
+                rightBounceFilter.setResonance(controls.bounceResonance);
+            }
+            break;
+        }
         
-        // Generate the waveforms
-        for (int j = 0; j < padChords.size(); j++)
+        case embellishmentLayer:
         {
-            padChords[j].setFilterCutOff(filterCutoffVal);
-            padChords[j].setLFOFrequency(LFOFreq);
-            padChords[j].setLFOAmount(LFOAmount);
-            outputValue += padChords[j].process();
+            pad.setFrequency(controls.padFrequency);
+            if (controls.hasNewParameters)
+                levels[embellishmentLevel].setTargetValue(controls.levels[embellishmentLevel]);
+            break;
         }
-        float padchordsSamples = outputValue / padChords.size();
-
-        // 2. Bounce
-        // apply high pass filter to reduce low frequency
-        float cutoff = lfo.process() * 1000.0f + 2000.0f; // moving filter
-        filter.setCoefficients(juce::IIRCoefficients::makeHighPass(sr, cutoff, 5.0f));
         
-        // select notes
-        float leftbounceFreq = leftbounceFreqSelector.process();
-        float rightbounceFreq = rightbounceFreqSelector.process();
+        case stringsLayer:
+        {
+            stringRootNote.setFrequency(controls.stringRootFrequency);
+            string.setFrequency(controls.stringFrequency);
+            stringOctaveUp.setFrequency(controls.stringFrequency * 2); // enrich timbre
+            
+            if (controls.hasNewParameters)
+            {
+                levels[stringOctaveUpLevel].setTargetValue(controls.levels[stringOctaveUpLevel]);
+                string.setVibratoFreq(controls.stringVibratoRate);
+                stringOctaveUp.setVibratoFreq(controls.stringVibratoRate);
+            }
+            break;
+        }
         
-        // Set frequencies selected by frequency selectors
-        leftBounce.setFrequency(leftbounceFreq);
-        rightBounce.setFrequency(rightbounceFreq);
+        case subbassLayer:
+        {
+            if (controls.hasNewModulation)
+                subbass.setDetuneFine(controls.subDetuneFine); // add dynamic timbre change
+            if (controls.hasNewParameters)
+                levels[subbassLevel].setTargetValue(controls.levels[subbassLevel]);
+            break;
+        }
         
-        // add dynamic timbre change
-        float LFOBounceFreq = (lfo2.process() + 1.0f) * 2.5 + 0.1; // scale it from -1-1 to 0.1-5
-        leftBounce.setLFOFrequency(LFOBounceFreq);
-        rightBounce.setLFOFrequency(LFOBounceFreq);
+        default:
+            break;
+    }
+}
+
+void AP_Assignment2AudioProcessor::applyControlsToLayers()
+{
+    for (int layer = 0; layer < numLayers; layer++)
+        applyLayerControls(Layer (layer), layerControls);
+    
+    layerControls.hasNewModulation = false;
+    layerControls.hasNewParameters = false;
+}
+
+void AP_Assignment2AudioProcessor::planSpan (int startSample, int numSamples)
+{
+    // The span takes a copy of the controls, so the layers can start it whenever they reach it
+    updateNoteControls();
+    auto& span = spans[(size_t) numSpans++];
+    span.start = startSample;
+    span.length = numSamples;
+    span.controls = layerControls;
+    layerControls.hasNewModulation = false;
+    layerControls.hasNewParameters = false;
+    
+    // === Amplitude Control ===
+    // The ramps the layers follow every sample are read here, in order, so no two layers read the same ramp
+    for (auto target : { ModulationEngine::movementLevel, ModulationEngine::leftVolume,
+                         ModulationEngine::stringRootVolume, ModulationEngine::stringRootSawAmount,
+                         ModulationEngine::stringOctaveUpSawAmount, ModulationEngine::subPulseWidth,
+                         ModulationEngine::subSquareAmount })
+    {
+        auto* values = modulationBuffer.getWritePointer(target, startSample);
+        for (int i = 0; i < numSamples; i++)
+            values[i] = modulation.getNextValue(target);
+    }
+}
+
+void AP_Assignment2AudioProcessor::renderSpans (float* leftChannel, float* rightChannel, int numSamples)
+{
+    // Every layer renders all planned spans into its own buffer, either one after another or on the worker
+    // threads, and the mix adds them up.
+    if (workerPool.getNumWorkers() > 0)
+    {
+        workerPool.run(numLayers, renderLayerJob, this);
+        profiler.lap(parallelLayersStage);
+    }
+    else
+    {
+        for (int layer = 0; layer < numLayers; layer++)
+        {
+            renderLayer(Layer (layer));
+            profiler.lap(padChordsStage + layer);
+        }
+    }
+    
+    
+    // === Final Mix ===
+    for (int i = 0; i < numSamples; i++)
+    {
+        // center(mono) - final mix
+        auto mixsamples = (padChordsBuffer[i] + stringsBuffer[i] + subbassBuffer[i]) / 2;
         
-        // Generate the raw waveforms
-        auto leftBouncerawSamples = leftBounce.process();
-        auto rightBouncerawSamples = rightBounce.process();
+        // stereo - final mix
+        leftChannel[i] = (mixsamples + (bounceLeftBuffer[i] + embellishmentLeftBuffer[i])) * smoothedVolume.getNextValue();
+        rightChannel[i] = (mixsamples + (bounceRightBuffer[i] + embellishmentRightBuffer[i])) * smoothedVolume.getNextValue();
+    }
+    
+    profiler.lap(mixStage);
+}
+
+void AP_Assignment2AudioProcessor::renderLayerJob (void* processor, int layer)
+{
+    static_cast<AP_Assignment2AudioProcessor*> (processor)->renderLayer(Layer (layer));
+}
+
+void AP_Assignment2AudioProcessor::renderLayer (Layer layer)
+{
+    for (int s = 0; s < numSpans; s++)
+    {
+        applyLayerControls(layer, spans[(size_t) s].controls);
+        renderLayerSpan(layer, spans[(size_t) s]);
+    }
+}
+
+void AP_Assignment2AudioProcessor::renderLayerSpan (Layer layer, const Span& span)
+{
+    auto numSamples = span.length;
+    auto* movement = modulationBuffer.getReadPointer(ModulationEngine::movementLevel, span.start);
+    
+    switch (layer)
+    {
+        // === Pad Synthesis ===
+        // 1. Pad chords (SIMD bank): all voices take the notes of this span, then are rendered at once.
+        //    The MIDI voices keep time while the built-in chords play, so their queued notes stay in step.
+        case padChordsLayer:
+        {
+            auto* out = padChordsBuffer.data() + span.start;
+            if (span.controls.isPlayingMidiChords)
+            {
+                midiChords.process(out, numSamples);
+            }
+            else
+            {
+                midiChords.skip(numSamples);
+                padChords.process(out, numSamples);
+            }
+            
+            // MIDI can play more voices than the four of the built-in chords, so it has a fixed gain of its own
+            auto voiceGain = span.controls.isPlayingMidiChords ? VoiceManager::outputGain : 1.0f / (float) padChords.getNumVoices();
+            for (int i = 0; i < numSamples; i++)
+                out[i] = out[i] * voiceGain * levels[padChordsLevel].getNextValue();
+            break;
+        }
         
-        // Process through the filter and add movement
-        auto leftBounceSamples = filter.processSingleSampleRaw(leftBouncerawSamples) * movementVal;
-        auto rightBounceSamples = filter.processSingleSampleRaw(rightBouncerawSamples) * movementVal;
+        // 2. Bounce
+        case bounceLayer:
+        {
+            auto* left = bounceLeftBuffer.data() + span.start;
+            auto* right = bounceRightBuffer.data() + span.start;
+            for (int i = 0; i < numSamples; i++)
+            {
+                // Generate the raw waveforms, process them through the filter and add movement
+                auto level = levels[bounceLevel].getNextValue();
+                left[i] = leftBounceFilter.processSample(leftBounce.process()) * movement[i] * level;
+                right[i] = rightBounceFilter.processSample(rightBounce.process()) * movement[i] * level;
+            }
+            break;
+        }
         
         // 3. Pad embellishment in high frequency
-        float padFrequency = padFreqSelector.process(); // select notes
-        pad.setFrequency(padFrequency); // Set frequencies selected by frequency selectors
-        auto padSamples = pad.process(); // Generate the waveforms
-        auto leftpadSamples = padSamples * leftVolume * 0.1; // panning and reduce the volume
-        auto rightpadSamples = padSamples * rightVolume * 0.1; // panning and reduce the volume
+        case embellishmentLayer:
+        {
+            auto* left = embellishmentLeftBuffer.data() + span.start;
+            auto* right = embellishmentRightBuffer.data() + span.start;
+            
+            // Once the quality governor has faded the layer out, the pad only keeps time
+            if (! embellishmentFade.isSmoothing() && embellishmentFade.getTargetValue() == 0.0f)
+            {
+                pad.skip(numSamples);
+                levels[embellishmentLevel].skip(numSamples);
+                std::fill_n(left, numSamples, 0.0f);
+                std::fill_n(right, numSamples, 0.0f);
+                break;
+            }
+            
+            auto* leftVolumes = modulationBuffer.getReadPointer(ModulationEngine::leftVolume, span.start);
+            for (int i = 0; i < numSamples; i++)
+            {
+                // Control the volume of the left and right channels independently to create a stereo effect.
+                float leftVolume = leftVolumes[i];
+                float rightVolume = 1 - leftVolume;
+                
+                auto padSamples = pad.process() * levels[embellishmentLevel].getNextValue() * embellishmentFade.getNextValue(); // Generate the waveforms and reduce the volume
+                left[i] = padSamples * leftVolume; // panning
+                right[i] = padSamples * rightVolume; // panning
+            }
+            break;
+        }
         
-
         // === String Synthesis ===
-        // 1. root note
-        stringRootNote.setFrequency(firstFrequency / 2);   // add string to emphasize the root note
-        auto stringRootVol =  (lfo2.process() + 1.0f) / 3; // scale it from -1-1 to 0-0.5
-        auto stringRootSA =  (lfo2.process() + 1.0f) / 2;  // scale it from -1-1 to 0.5-1
-        stringRootNote.setSawAmount(stringRootSA);         // add dynamic timbre change
-        auto stringRootSamples = stringRootNote.process() * stringRootVol;
-        
-        // 2. motif
-        float stringFrequency = stringFreqSelector.process(); // select notes
-        auto stringOctUpSA =  (lfo.process() + 1.0f) / 4 + 0.5; // scale it from -1-1 to 0.5-1
-        string.setFrequency(stringFrequency); // Set frequencies selected by frequency selectors
-        stringOctaveUp.setFrequency(stringFrequency * 2); // enrich timbre
-        stringOctaveUp.setSawAmount(stringOctUpSA); // add dynamic timbre change
-        auto stringSamples = (string.process() + stringOctaveUp.process() * 0.9) / 2; // scale it to normal level
-       
+        case stringsLayer:
+        {
+            auto* out = stringsBuffer.data() + span.start;
+            auto* rootVolumes = modulationBuffer.getReadPointer(ModulationEngine::stringRootVolume, span.start);
+            auto* rootSawAmounts = modulationBuffer.getReadPointer(ModulationEngine::stringRootSawAmount, span.start);
+            auto* octaveUpSawAmounts = modulationBuffer.getReadPointer(ModulationEngine::stringOctaveUpSawAmount, span.start);
+            for (int i = 0; i < numSamples; i++)
+            {
+                // 1. root note
+                stringRootNote.setSawAmount(rootSawAmounts[i]);         // add dynamic timbre change
+                auto stringRootSamples = stringRootNote.process() * rootVolumes[i];
+                
+                // 2. motif
+                stringOctaveUp.setSawAmount(octaveUpSawAmounts[i]); // add dynamic timbre change
+                auto octaveUpLevel = levels[stringOctaveUpLevel].getNextValue();
+                auto stringSamples = (string.process() + stringOctaveUp.process() * octaveUpLevel) / 2; // scale it to normal level
+                
+                out[i] = stringSamples + stringRootSamples;
+            }
+            break;
+        }
         
         // === Sub Bass Synthesis ===
-        float subPulseWidth = (lfo2.process() + 1.0f) / 4; // scale it from -1-1 to 0-0.5
-        float squareAmount = (lfo.process() + 1.0f) / 4 + 0.25; // scale it from -1-1 to 0.25-0.75
-        int detuneFine = int (lfo.process() * 30); // scale it from -1-1 to -30-30
-        subbass.setSquarePulseWidth(subPulseWidth); // add dynamic timbre change
-        subbass.setDetuneFine(detuneFine); // add dynamic timbre change
-        subbass.setSquareAmount(squareAmount); // add dynamic timbre change
-        auto subbassSamples = subbass.process() * (movementVal * 0.5 + 0.5) ; // add subtle movement
-        
-        // === Final Mix ===
-        // center(mono) - final mix
-        auto mixsamples = (padchordsSamples + stringSamples + subbassSamples * 0.3 + stringRootSamples) / 2;
-        
-        // stereo - final mix
-         auto mixL = (mixsamples + leftBounceSamples * 0.4 + leftpadSamples) * smoothedVolume.getNextValue();
-         auto mixR = (mixsamples + rightBounceSamples * 0.4 + rightpadSamples) * smoothedVolume.getNextValue();
+        // Everything the subbass produces lies far below the host Nyquist frequency, so it runs at a lower rate.
+        // Each subbass sample is upsampled into subbassFrame, which is read over the next host samples.
+        case subbassLayer:
+        {
+            auto* out = subbassBuffer.data() + span.start;
+            auto* pulseWidths = modulationBuffer.getReadPointer(ModulationEngine::subPulseWidth, span.start);
+            auto* squareAmounts = modulationBuffer.getReadPointer(ModulationEngine::subSquareAmount, span.start);
+            for (int i = 0; i < numSamples; i++)
+            {
+                if (subbassPhase == 0)
+                {
+                    subbass.setSquarePulseWidth(pulseWidths[i]); // add dynamic timbre change
+                    subbass.setSquareAmount(squareAmounts[i]); // add dynamic timbre change
+                    subbassUpsampler.processSample(subbass.process(), subbassFrame.data());
+                }
+                
+                auto subbassSamples = subbassFrame[subbassPhase] * (movement[i] * 0.5f + 0.5f); // add subtle movement
+                if (++subbassPhase == subbassUpsampler.getFactor())
+                    subbassPhase = 0;
+                
+                out[i] = subbassSamples * levels[subbassLevel].getNextValue();
+            }
+            break;
+        }
         
-        // final output
-        leftChannel[i] = mixL;
-        rightChannel[i] = mixR;
+        default:
+            break;
     }
-    // Apply stereo reverb to the final mix
-    reverb.processStereo(leftChannel, rightChannel, numSamples);
 }
 
 //==============================================================================
@@ -416,12 +1470,50 @@ void AP_Assignment2AudioProcessor::getStateInformation (juce::MemoryBlock& destD
     // You should use this method to store your parameters in the memory block.
     // You could do that either as raw data, or use the XML or ValueTree classes
     // as intermediaries to make it easy to save and load complex data.
+    // The parameters and the seed are written in the ValueTree's binary format, which is much smaller than XML.
+    auto state = parameters.copyState();
+    state.setProperty(seedProperty, (juce::int64) randomSeed.load(), nullptr);
+    state.setProperty(patchProperty, modulationPatch, nullptr);
+    {
+        const juce::ScopedLock lock (scoreLock);
+        state.setProperty(scoreProperty, scoreFile.getFullPathName(), nullptr);
+    }
+    
+    juce::MemoryOutputStream stream (destData, false);
+    state.writeToStream(stream);
 }
 
 void AP_Assignment2AudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
     // You should use this method to restore your parameters from this memory block,
     // whose contents will have been created by the getStateInformation() call.
+    auto state = juce::ValueTree::readFromData(data, (size_t) sizeInBytes);
+    if (! state.hasType(stateType))
+        return;
+    
+    if (state.hasProperty(seedProperty))
+        setRandomSeed((juce::uint64) (juce::int64) state.getProperty(seedProperty));
+    
+    // States saved before there were patches play the default one
+    setModulationPatch(state.getProperty(patchProperty, ModulationPatch::getDefault()).toString());
+    
+    // A score that has moved or gone leaves the built-in sequences playing
+    auto scorePath = state.getProperty(scoreProperty).toString();
+    if (scorePath.isEmpty() || loadScore(juce::File(scorePath)).failed())
+        loadScore(juce::File());
+    
+    // States saved before there were parameters leave them at their defaults
+    parameters.replaceState(state);
+}
+
+void AP_Assignment2AudioProcessor::setRandomSeed (juce::uint64 seed)
+{
+    randomSeed = seed;
+}
+
+juce::uint64 AP_Assignment2AudioProcessor::getRandomSeed() const
+{
+    return randomSeed.load();
 }
 
 //==============================================================================
@@ -9,13 +9,27 @@
 #pragma once
 
 #include <JuceHeader.h>
-#include "vector"
+#include <array>
+#include <memory>
+#include <vector>
 #include "Oscillators.h"
 #include "StringSynth.h"
 #include "PadSynth.h"
+#include "PadSynthBank.h"
+#include "VoiceManager.h"
 #include "Movement.h"
 #include "Subbass.h"
 #include "FrequencySelector.h"
+#include "Score.h"
+#include "LockFreeExchange.h"
+#include "ModulationEngine.h"
+#include "ModulationPatch.h"
+#include "StateVariableFilter.h"
+#include "StageProfiler.h"
+#include "HalfBandUpsampler.h"
+#include "RealtimeWorkerPool.h"
+#include "PipelinedReverb.h"
+#include "QualityGovernor.h"
 
 //==============================================================================
 /**
@@ -60,27 +74,301 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
+    //==============================================================================
+    // Sets how many samples pass between two evaluations of the LFOs (safe to call from any thread)
+    void setControlInterval (int numSamples);
+    
+    // Renders the layers in parallel on numWorkers real-time threads plus the audio thread; 0 (the default)
+    // renders everything on the audio thread. Takes effect at the next prepareToPlay().
+    void setNumWorkerThreads (int numWorkers);
+    
+    // Runs the reverb on its own thread, one block behind the audio thread, and reports that block as latency.
+    // Takes effect at the next prepareToPlay().
+    void setReverbPipelined (bool shouldBePipelined);
+    
+    // Sets the seed of the random note choices, which is saved with the plugin state. The same seed gives
+    // bit-identical output. Takes effect at the next prepareToPlay() or processBlock(), which restarts the piece from it.
+    void setRandomSeed (juce::uint64 seed);
+    juce::uint64 getRandomSeed() const;
+    
+    // Keeps the phases of all oscillators and LFOs as 32-bit fixed-point numbers instead of floats, so they do not drift
+    // over days of playback. seekTo() then lands on the phases of a continuous render, exactly for the voices without
+    // vibrato. Takes effect at the next prepareToPlay().
+    void setFixedPointPhase (bool shouldUseFixedPoint);
+    
+    // Sets how many times lower than the host rate the subbass is rendered: 1, 2, 4 or 8 (safe to call from any thread)
+    void setSubbassRateFactor (int factor);
+    
+    // Jumps to a sample position of the piece, as if it had been played from the start. Notes, random choices and
+    // oscillator phases are moved there without rendering, then the pre-roll just before the position is rendered and
+    // thrown away to settle the filters and the reverb. Held MIDI notes are released. Call after prepareToPlay(), from
+    // the thread that calls processBlock(). The LFOs are still evaluated once per control interval on the way, so the
+    // time this takes grows with the distance: processBlock() only seeks like this offline, and spreads a jump of the
+    // host's transport in real time over several blocks.
+    void seekTo (juce::int64 position);
+    
+    // Sets the pre-roll of seekTo(). The default 50 ms settle the voices; the reverb needs getTailLengthSeconds().
+    // Safe to call from any thread.
+    void setSeekPreRoll (double seconds);
+    
+    // The note sequences of the piece, one per FrequencySelector
+    enum Sequence
+    {
+        chordRoots,
+        chordThirds,
+        chordFifths,
+        chordSevenths,
+        leftBounceNotes,
+        rightBounceNotes,
+        stringMotif,
+        padEmbellishment,
+        numSequences
+    };
+    
+    // Replaces a sequence while audio runs, without locking or allocating on the audio thread. The sample rate and
+    // the hold duration in newParameters are ignored; the sequence's hold parameter sets the latter. Call from one
+    // thread only, e.g. the message thread.
+    void setSequence (Sequence sequence, const FrequencySelector::Parameters& newParameters);
+    
+    // Name of a sequence, as score files refer to it
+    static const char* getSequenceName (Sequence sequence);
+    
+    // Plays the layers of a binary score file (see Score) in place of the sequences of the same names; sequences the
+    // score has no layer for keep their notes. The file is memory-mapped and checked here, and its path is saved with
+    // the plugin state. An empty juce::File returns to the built-in sequences. Returns the problem, and keeps the
+    // current score, if the file is not a valid score. Takes effect while audio runs: each sequence plays its current
+    // note to the end and then starts the new layer from its first event. Call from one thread only, e.g. the message thread.
+    juce::Result loadScore (const juce::File& file);
+    
+    // Replaces the modulation patch, i.e. the LFOs that animate the piece and what they are routed to (see
+    // ModulationPatch), while audio runs. The patch is saved with the plugin state. Returns the problem, and keeps the
+    // current patch, if json is not a valid patch. Call from one thread only, e.g. the message thread.
+    juce::Result setModulationPatch (const juce::String& json);
+    juce::String getModulationPatch() const;
+    
+    //==============================================================================
+    // The host-automatable parameters. Their defaults are the values the piece was composed with. The audio thread
+    // reads the host's values once per block, and scheduled and MIDI controller changes at their sample. The levels
+    // ramp to new values over levelRampTime, the rest apply at once.
+    enum Parameter
+    {
+        padChordsLevel,         // layer levels, the factors the layers are mixed with
+        bounceLevel,
+        embellishmentLevel,
+        stringOctaveUpLevel,
+        subbassLevel,
+        reverbRoomSize,         // reverb, as in juce::Reverb::Parameters
+        reverbDamping,
+        reverbWetLevel,
+        reverbDryLevel,
+        reverbWidth,
+        chordsHold,             // seconds each note of a sequence is held
+        leftBounceHold,
+        rightBounceHold,
+        stringHold,
+        embellishmentHold,
+        lfoRate,                // rates of the modulation sources, see ModulationEngine::Settings
+        lfo2Rate,
+        panRate,
+        movementRate,
+        stringVibratoRate,      // vibrato of the motif strings
+        padCutoffMin,           // ranges the filter cutoffs are swept over
+        padCutoffMax,
+        bounceCutoffMin,
+        bounceCutoffMax,
+        bounceResonance,
+        numParameters
+    };
+    
+    static constexpr double levelRampTime = 0.05;
+    
+    // The parameters, and the plugin state they are saved in
+    juce::AudioProcessorValueTreeState& getValueTreeState();
+    
+    // Changes a parameter at a sample position of the piece, so automation lands exactly where it was written, and
+    // stays until the host's own value of the parameter changes. Changes to positions that have already been played
+    // apply at the start of the next block. Lock-free; call from one thread only. Returns false when the queue is full.
+    bool scheduleParameterChange (Parameter parameter, float value, juce::int64 position);
+    
+    // Makes a MIDI controller set a parameter, over its whole range, at the sample position of each CC message.
+    // By default CC 74 (brightness) sets padCutoffMax and CC 91 (reverb depth) sets reverbWetLevel. Pass
+    // numParameters to unmap a controller. Safe to call from any thread.
+    void setControllerParameter (int controller, Parameter parameter);
+    
+    // Parameter changes less than numSamples after the start of a span wait for its end instead of splitting it,
+    // which bounds the cost of dense automation. MIDI notes always play at their exact sample. Safe to call from any thread.
+    void setMinimumSubBlockSize (int numSamples);
+    
+    //==============================================================================
+    // The stages of processBlock, in the order they run
+    enum Stage
+    {
+        modulationStage,    // MIDI, LFOs and control-rate parameter and filter updates
+        padChordsStage,
+        bounceStage,
+        embellishmentStage,
+        stringsStage,
+        subbassStage,
+        parallelLayersStage, // all layers, when they are rendered by the worker threads
+        mixStage,
+        reverbStage,
+        numStages
+    };
+    
+    using Profiler = StageProfiler<numStages>;
+    
+    static const char* getStageName (Stage stage);
+    
+    // Turns the per-stage CPU measurement on or off. It is off by default and costs nothing then.
+    void setProfilingEnabled (bool shouldProfile);
+    
+    // Returns the share of the real-time budget each stage used since the previous call (message thread)
+    Profiler::Snapshot getProfilerSnapshot();
+    
+    //==============================================================================
+    // The steps the quality governor takes when blocks come close to their deadline, each one on top of the previous
+    enum QualityLevel
+    {
+        fullQuality,
+        coarseControlRate,      // LFOs evaluated half as often
+        fewerPadVoices,         // half the MIDI chord voices
+        cheapReverb,            // reverb without tap modulation
+        noEmbellishment,        // the embellishment layer faded out and not rendered
+        numQualityLevels
+    };
+    
+    // Lets the governor lower the quality under load (the default), or keeps full quality. Offline renders always
+    // run at full quality. Safe to call from any thread.
+    void setQualityGovernorEnabled (bool shouldBeEnabled);
+    
+    // Returns the governor's load histogram, its counters and the current quality level (any thread)
+    QualityGovernor::Snapshot getQualitySnapshot() const;
+
 private:
+    // Longest run of samples a layer renders in one go
+    static constexpr int maxSpanLength = 256;
+    
     // ============================== processor ====================================
     
-    // filter
+    // filter (one per bounce channel, so each keeps its own state)
      float sr; // samplerate
-     juce::IIRFilter filter;
+     StateVariableFilter leftBounceFilter;
+     StateVariableFilter rightBounceFilter;
+    
+    // reverb, a feedback delay network with juce::Reverb's parameters, optionally run a block behind on its own thread
+    PipelinedReverb reverb;
+    std::atomic<bool> pipelinedReverb { false };
+    
+    // lfos and movement(amplitude control), evaluated at control rate as the patch's schedule says
+    ModulationEngine modulation;
+    std::atomic<int> controlInterval { 32 };
+    juce::String modulationPatch;                                           // owned by the thread that sets it
+    ModulationEngine::Schedule modulationSchedule;                          // owned by the audio thread
+    LockFreeExchange<ModulationEngine::Schedule> pendingModulationSchedule;
+    
+    // float or fixed-point oscillator phases
+    std::atomic<bool> fixedPointPhase { false };
+    
+    // The independent parts of the mix, rendered one after another or in parallel
+    enum Layer
+    {
+        padChordsLayer,
+        bounceLayer,
+        embellishmentLayer,
+        stringsLayer,
+        subbassLayer,
+        numLayers
+    };
+    
+    // What the layers take from the serial part of the audio thread at the start of a span: the notes, and the
+    // control-rate modulation and the parameters that set voices, which are only handed over when they have changed
+    static constexpr int numLevels = subbassLevel + 1;
+    struct LayerControls
+    {
+        std::array<float, 4> chordFrequencies {};
+        float leftBounceFrequency = 0.0f;
+        float rightBounceFrequency = 0.0f;
+        float padFrequency = 0.0f;
+        float stringRootFrequency = 0.0f;
+        float stringFrequency = 0.0f;
+        bool isPlayingMidiChords = false;
+        
+        bool hasNewModulation = false;
+        float padCutoff = 0.0f;
+        float padLFOFrequency = 0.0f;
+        float padLFOAmount = 0.0f;
+        float bounceCutoff = 0.0f;
+        float bounceLFOFrequency = 0.0f;
+        int subDetuneFine = 0;
+        
+        bool hasNewParameters = false;
+        std::array<float, numLevels> levels {};
+        float stringVibratoRate = 0.0f;
+        float bounceResonance = 0.0f;
+    };
+    
+    // A span of the part of the block being rendered, and the controls its layers start with
+    struct Span
+    {
+        int start = 0;
+        int length = 0;
+        LayerControls controls;
+    };
+    
+    // The serial part plans all spans of a block, or of as much of it as the buffers hold, before any layer renders.
+    // Each layer then renders them all on its own, so the worker threads meet the audio thread once per block.
+    LayerControls layerControls;                // the latest controls, owned by the serial part
+    std::vector<Span> spans;
+    int numSpans = 0;
+    int blockCapacity = 0;                      // samples the buffers below hold
+    
+    // the modulation targets the layers read every sample, one channel each, for the part of the block planned
+    juce::AudioBuffer<float> modulationBuffer;
+    
+    // output of each layer within the part of the block planned
+    std::vector<float> bounceLeftBuffer;
+    std::vector<float> bounceRightBuffer;
+    std::vector<float> embellishmentLeftBuffer;
+    std::vector<float> embellishmentRightBuffer;
+    std::vector<float> stringsBuffer;
+    std::vector<float> subbassBuffer;
+    
+    // worker threads for parallel layer rendering
+    RealtimeWorkerPool workerPool;
+    std::atomic<int> numWorkerThreads { 0 };
+    
+    // CPU use of each stage
+    Profiler profiler;
     
-    // reverb
-    juce::Reverb reverb;
+    // quality level the audio thread renders at, set by the governor from the time the blocks take
+    QualityGovernor governor;
+    int qualityLevel = fullQuality;
+    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> embellishmentFade;
     
-    // movement(amplitude control)
-    Movement movement;
+    // position in the piece of the next sample to render, and the scratch buffer seekTo() renders its pre-roll into
+    juce::int64 timelinePosition = 0;
+    juce::AudioBuffer<float> seekBuffer;
+    std::atomic<double> seekPreRoll { 0.05 };
+    
+    // A jump of the host's transport in real time: the dry mix fades out over one block, the next blocks skip one note
+    // for every samplesPerSkippedNote samples they hold towards where the host plays, silent but for the reverb tail,
+    // and once there the dry mix fades back in over transportFadeTime seconds. Skipping a note takes about as long as
+    // rendering a sample, so a skipping block takes a fraction of the time a rendered one does.
+    enum class TransportJump
+    {
+        none,
+        fadingOut,
+        skipping
+    };
+    static constexpr int samplesPerSkippedNote = 4;
+    static constexpr double transportFadeTime = 0.05;
+    TransportJump transportJump = TransportJump::none;
+    juce::int64 jumpTarget = 0;     // where the host plays the next block from, should it stop saying so
+    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> transportFade;
     
     // fade in & out
     juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> smoothedVolume;
     
-    // lfos
-    SinOsc volLfo;
-    SinOsc lfo;
-    PadSynth lfo2;
-    
     // ============================== timbre ====================================
     
     // StringSynth
@@ -89,27 +377,192 @@ private:
     StringSynth stringRootNote;
     
     // PadSynth
-    std::vector<PadSynth> padChords;
+    PadSynthBank<4> padChords;                          // built-in chord progression, rendered in SIMD lanes
+    VoiceManager midiChords;                            // chords played from MIDI input
+    bool isPlayingMidiChords = false;                   // set by the first note-on, until prepareToPlay or a jump
+    std::vector<float> padChordsBuffer;
     PadSynth leftBounce;
     PadSynth rightBounce;
     PadSynth pad;
     
-    // Subbass
+    // Subbass, rendered at the host rate divided by subbassRateFactor and upsampled
     Subbass subbass;
+    HalfBandUpsampler subbassUpsampler;
+    std::array<float, HalfBandUpsampler::maxFactor> subbassFrame;   // host-rate samples of the current subbass sample
+    int subbassPhase = 0;                                           // next sample to read from subbassFrame
+    std::atomic<int> subbassRateFactor { 4 };
+    
+    // Sets the subbass up for its internal rate
+    void prepareSubbass();
     
     // =========================== FrequencySelector ===========================
     
-    FrequencySelector chordsFreqSelector1;
-    FrequencySelector chordsFreqSelector2;
-    FrequencySelector chordsFreqSelector3;
-    FrequencySelector chordsFreqSelector4;
-    std::vector<FrequencySelector> chordsFreqSelector;
+    std::array<FrequencySelector, 4> chordsFreqSelector;
     
     FrequencySelector leftbounceFreqSelector;
     FrequencySelector rightbounceFreqSelector;
     FrequencySelector stringFreqSelector;
     FrequencySelector padFreqSelector;
     
+    // Current sequence of each selector, and sequences handed over from other threads
+    std::array<FrequencySelector::Parameters, numSequences> sequences;
+    std::array<LockFreeExchange<FrequencySelector::Parameters>, numSequences> pendingSequences;
+    
+    // Scores: loadScore() maps each one and looks up its layers, which the audio thread picks up under the serial
+    // number of the load. The audio thread reports the serial it plays, and only ever moves on to newer ones, so
+    // loadScore() frees the scores loaded before it on the message thread.
+    struct ScoreLayers
+    {
+        juce::uint32 serial = 0;
+        std::array<Score::Layer, numSequences> layers;  // empty for the sequences the score has no layer for
+    };
+    struct LoadedScore
+    {
+        juce::uint32 serial;
+        std::unique_ptr<Score> score;
+    };
+    ScoreLayers scoreLayers;                                                // owned by the audio thread
+    LockFreeExchange<ScoreLayers> pendingScoreLayers;
+    std::atomic<juce::uint32> playingScoreSerial { 0 };
+    std::vector<LoadedScore> loadedScores;                                  // guarded by scoreLock, oldest first
+    juce::uint32 lastScoreSerial = 0;
+    juce::File scoreFile;
+    juce::CriticalSection scoreLock;
+    
+    // seed of the selectors' generators; a new instance starts from a random one
+    std::atomic<juce::uint64> randomSeed { (juce::uint64) juce::Random::getSystemRandom().nextInt64() };
+    juce::uint64 appliedSeed = 0;                                           // the one the piece last restarted from, owned by the audio thread
+    
+    // plugin state
+    static inline const juce::Identifier stateType { "WanderingInCycle" };
+    static inline const juce::Identifier seedProperty { "seed" };
+    static inline const juce::Identifier patchProperty { "modulationPatch" };
+    static inline const juce::Identifier scoreProperty { "scoreFile" };
+    
+    // ============================== parameters ====================================
+    
+    juce::AudioProcessorValueTreeState parameters { *this, nullptr, stateType, createParameterLayout() };
+    std::array<std::atomic<float>*, numParameters> parameterValues;         // written by the host, read by the audio thread
+    std::array<juce::RangedAudioParameter*, numParameters> parameterObjects;
+    
+    // values the audio thread renders with, and the host values they last followed
+    std::array<float, numParameters> currentParameters {};
+    std::array<float, numParameters> lastHostParameters {};
+    
+    // layer levels, ramped towards their parameters
+    std::array<juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear>, numLevels> levels;
+    
+    // A parameter change at a position of the piece
+    struct ParameterEvent
+    {
+        juce::int64 position;
+        Parameter parameter;
+        float value;
+    };
+    
+    // scheduled parameter changes, handed over from another thread and then kept in order of position
+    static constexpr int maxParameterEvents = 256;
+    juce::AbstractFifo parameterEventFifo { maxParameterEvents };
+    std::array<ParameterEvent, maxParameterEvents> parameterEventQueue;
+    std::array<ParameterEvent, maxParameterEvents> pendingParameterEvents;  // owned by the audio thread
+    int numPendingParameterEvents = 0;
+    
+    // parameter set by each MIDI controller, numParameters for none
+    std::array<std::atomic<int>, 128> controllerParameters;
+    std::atomic<int> minimumSubBlockSize { 32 };
+    
+    static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
+    
+    // Current host value of a parameter (any thread)
+    float getParameterValue (Parameter parameter) const;
+    
+    // The parameter that sets how long the notes of a sequence are held
+    static Parameter getHoldParameter (Sequence sequence);
+    
+    // Renders with a new parameter value from the next sample on: hands it to the layers at the start of the next span,
+    // or to the modulation, the reverb or the selectors it belongs to
+    void setParameterValue (Parameter parameter, float value);
+    
+    // Picks up the parameters the host has changed since the previous block
+    void pullHostParameters();
+    
+    // Moves the changes published by scheduleParameterChange() in among the pending ones
+    void pullParameterEvents();
+    
+    // Applies the pending changes up to a position of the piece
+    void applyParameterEvents (juce::int64 position);
+    
+    // Returns the parameter a MIDI message sets, or numParameters when it sets none
+    Parameter getControllerParameter (const juce::MidiMessage& message) const;
+    
+    // Whether a MIDI message starts or ends notes, so that it has to take effect at its exact sample
+    static bool isNoteMessage (const juce::MidiMessage& message);
+    
+    // Fills sequences with the composition
+    void initialiseSequences();
+    
+    // Returns the selector that plays a sequence
+    FrequencySelector& getFrequencySelector (Sequence sequence);
+    
+    // Samples until the first of the sequences moves to its next note
+    int getNumSamplesToNextNoteChange();
+    
+    // Applies the sequences published by setSequence()
+    void pullPendingSequences();
+    
+    // Handles one incoming MIDI message at its sample position
+    void handleMidiEvent (const juce::MidiMessage& message);
+    
+    // Takes the parameters that only change once per control interval into layerControls
+    void updateModulationControls();
+    
+    // Takes the current notes of the sequences into layerControls
+    void updateNoteControls();
+    
+    // Hands controls to the voices, filters and levels of one layer, on the thread that renders it
+    void applyLayerControls (Layer layer, const LayerControls& controls);
+    
+    // Hands layerControls to every layer at once, while none is rendering
+    void applyControlsToLayers();
+    
+    // Returns everything that moves along the piece to its first sample
+    void restartTimeline();
+    
+    // Moves the piece on by numSamples without rendering them, or by at most maxNotes notes, and returns how far it
+    // moved. An exact skip evaluates the LFOs at every control interval, as renderBlock() does, so the voices land on
+    // the phases of a continuous render; otherwise the LFOs move over each note in closed form, and the time the skip
+    // takes grows with the number of notes only.
+    juce::int64 skipTimeline (juce::int64 numSamples, int maxNotes, bool isExact);
+    
+    // Follows the host's transport at the start of a block. Returns false for a block of a real-time jump, which is
+    // not rendered.
+    bool followHostTransport (int numSamples);
+    
+    // Moves the voices that follow the control rate on by numSamples without rendering them
+    void skipSpan (int numSamples);
+    
+    // Switches the voices, the reverb and the embellishment to a quality level (audio thread)
+    void applyQualityLevel (int level);
+    
+    // Renders the next numSamples samples of the piece, reverb included, playing the MIDI events at their positions
+    void renderBlock (float* leftChannel, float* rightChannel, int numSamples, const juce::MidiBuffer& midiMessages);
+    
+    // Adds a span of numSamples samples at startSample of the part of the block being planned, with the current notes
+    // and controls, and reads the modulation its layers follow every sample
+    void planSpan (int startSample, int numSamples);
+    
+    // Renders the planned spans of every layer, one layer after another or in parallel, and mixes numSamples samples
+    void renderSpans (float* leftChannel, float* rightChannel, int numSamples);
+    
+    // Renders all planned spans of one layer into its buffer. Layers share no state, so they can run on any thread.
+    void renderLayer (Layer layer);
+    
+    // Renders one span of a layer
+    void renderLayerSpan (Layer layer, const Span& span);
+    
+    // RealtimeWorkerPool job that renders one layer
+    static void renderLayerJob (void* processor, int layer);
+    
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AP_Assignment2AudioProcessor)
 };
@@ -0,0 +1,163 @@
+/*
+  ==============================================================================
+
+    QualityGovernor.h
+    Created: 18 Oct 2026 2:47:31am
+    Author:  70
+
+  ==============================================================================
+*/
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <cmath>
+
+/**
+    Lowers the processing quality step by step when blocks come close to their real-time deadline, and raises it again when the load falls.
+
+    The audio thread marks the start of a block with beginBlock() and reports it with endBlock(). The governor compares the time the block took with its budget, numSamples / sampleRate, and follows that load with an average over about averagingTime seconds. When a block overruns its budget, or the average rises above stepDownLoad, the level goes up by one, i.e. the quality goes down by one step. Once the average has stayed below stepUpLoad for stepUpTime seconds, the level goes back down by one. After every step the governor waits settleTime seconds before stepping down again, so the cheaper setting has time to show in the measurements. The audio thread renders at getLevel(), 0 being full quality. A histogram of the load and a few counters are kept in atomics, so any thread can read them with getSnapshot() without locking.
+*/
+class QualityGovernor
+{
+public:
+    static constexpr int numHistogramBins = 16;     // load in steps of 10%, the last bin holding 150% and more
+    static constexpr double stepDownLoad = 0.8;     // average share of the budget that makes the governor step down
+    static constexpr double stepUpLoad = 0.5;       // average share below which it steps back up
+    static constexpr double averagingTime = 0.1;    // seconds of audio the average load follows
+    static constexpr double settleTime = 0.5;       // seconds of audio after a step before the next step down
+    static constexpr double stepUpTime = 2.0;       // seconds of audio at low load before a step up
+
+    struct Snapshot
+    {
+        std::array<juce::int64, numHistogramBins> histogram {};  // blocks per load bin
+        juce::int64 numBlocks = 0;
+        juce::int64 numOverruns = 0;    // blocks that took longer than their budget
+        juce::int64 numStepsDown = 0;   // steps to a lower quality
+        juce::int64 numStepsUp = 0;     // steps back to a higher quality
+        float averageLoad = 0.0f;       // the governor's average, as a share of the budget
+        int level = 0;                  // steps below full quality
+    };
+
+    // Sets the sample rate and the lowest quality level, returns to full quality and clears the counters.
+    // Call when the audio thread is not running.
+    void prepare(double SR, int maximumLevel)
+    {
+        sampleRate = SR;
+        maxLevel = juce::jmax(0, maximumLevel);
+        level = 0;
+        averageLoad = 0.0f;
+        average = 0.0;
+        secondsSinceStep = settleTime;
+        secondsAtLowLoad = 0.0;
+
+        for (auto& bin : histogram)
+            bin = 0;
+        numBlocks = 0;
+        numOverruns = 0;
+        numStepsDown = 0;
+        numStepsUp = 0;
+    }
+
+    // Lets the governor change the level (the default), or holds it at full quality. Safe to call from any thread.
+    void setEnabled(bool shouldBeEnabled)
+    {
+        enabled = shouldBeEnabled;
+    }
+
+    bool isEnabled() const
+    {
+        return enabled.load();
+    }
+
+    // The level the audio thread should render at, 0 being full quality
+    int getLevel() const
+    {
+        return level.load(std::memory_order_relaxed);
+    }
+
+    // Audio thread: starts timing a block
+    void beginBlock()
+    {
+        blockStart = juce::Time::getHighResolutionTicks();
+    }
+
+    // Audio thread: measures a block of numSamples samples and decides the level for the next one. Blocks that are not
+    // representative of the load, such as offline renders or blocks that seek, are counted but do not move the level.
+    void endBlock(int numSamples, bool mayChangeLevel)
+    {
+        if (numSamples <= 0)
+            return;
+
+        auto budget = numSamples / sampleRate;
+        auto load = (double) (juce::Time::getHighResolutionTicks() - blockStart) / ticksPerSecond / budget;
+
+        auto bin = juce::jlimit(0, numHistogramBins - 1, (int) (load * 10.0));
+        histogram[(size_t) bin].fetch_add(1, std::memory_order_relaxed);
+        numBlocks.fetch_add(1, std::memory_order_relaxed);
+        if (load > 1.0)
+            numOverruns.fetch_add(1, std::memory_order_relaxed);
+
+        // Exponential average, weighted by the length of the block so it does not depend on the block size
+        average += (load - average) * (1.0 - std::exp(-budget / averagingTime));
+        averageLoad.store((float) average, std::memory_order_relaxed);
+
+        secondsSinceStep += budget;
+        secondsAtLowLoad = average < stepUpLoad ? secondsAtLowLoad + budget : 0.0;
+
+        auto current = level.load(std::memory_order_relaxed);
+        auto next = current;
+        if (! enabled.load(std::memory_order_relaxed))
+            next = 0;
+        else if (mayChangeLevel && current < maxLevel && secondsSinceStep >= settleTime && (load > 1.0 || average > stepDownLoad))
+            next = current + 1;
+        else if (mayChangeLevel && current > 0 && secondsAtLowLoad >= stepUpTime)
+            next = current - 1;
+
+        if (next == current)
+            return;
+
+        (next > current ? numStepsDown : numStepsUp).fetch_add(1, std::memory_order_relaxed);
+        level.store(next, std::memory_order_relaxed);
+        secondsSinceStep = 0.0;
+        secondsAtLowLoad = 0.0;
+    }
+
+    // Returns the counters and the histogram since prepare(). Safe to call from any thread.
+    Snapshot getSnapshot() const
+    {
+        Snapshot snapshot;
+        for (int bin = 0; bin < numHistogramBins; ++bin)
+            snapshot.histogram[(size_t) bin] = histogram[(size_t) bin].load();
+        snapshot.numBlocks = numBlocks.load();
+        snapshot.numOverruns = numOverruns.load();
+        snapshot.numStepsDown = numStepsDown.load();
+        snapshot.numStepsUp = numStepsUp.load();
+        snapshot.averageLoad = averageLoad.load();
+        snapshot.level = level.load();
+        return snapshot;
+    }
+
+private:
+    const double ticksPerSecond = (double) juce::Time::getHighResolutionTicksPerSecond();
+
+    std::atomic<bool> enabled { true };
+    std::atomic<int> level { 0 };
+
+    // Shared with the readers
+    std::array<std::atomic<juce::int64>, numHistogramBins> histogram {};
+    std::atomic<juce::int64> numBlocks { 0 };
+    std::atomic<juce::int64> numOverruns { 0 };
+    std::atomic<juce::int64> numStepsDown { 0 };
+    std::atomic<juce::int64> numStepsUp { 0 };
+    std::atomic<float> averageLoad { 0.0f };
+
+    // Owned by the audio thread
+    double sampleRate = 44100.0;
+    int maxLevel = 0;
+    juce::int64 blockStart = 0;
+    double average = 0.0;
+    double secondsSinceStep = settleTime;
+    double secondsAtLowLoad = 0.0;
+};
@@ -0,0 +1,185 @@
+/*
+  ==============================================================================
+
+    RealtimeWorkerPool.h
+    Created: 17 Oct 2026 8:02:47pm
+    Author:  70
+
+  ==============================================================================
+*/
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+#if JUCE_INTEL
+ #include <immintrin.h>
+#endif
+
+/**
+    Runs a batch of independent jobs on a few real-time worker threads and the calling thread, then waits for all of them.
+
+    RealtimeWorkerPool is meant for the audio thread, with one batch per audio block. run() publishes a batch and takes part in it itself. Jobs are handed out through an atomic ticket that holds the batch number and the next job index, so no lock is taken and a worker that wakes up late cannot take a job from the wrong batch. run() then waits on an atomic barrier until every job has finished, spinning with a CPU pause hint rather than yielding, so the audio thread keeps its core. The workers are real-time threads pinned to their own cores. Between batches they sleep on an event, and are only woken when they are sleeping. Because the calling thread works through the batch too, it always completes, even if a worker is late. Start the workers with start() from a non-real-time thread, and call run() once per batch.
+*/
+class RealtimeWorkerPool
+{
+public:
+    // A job of a batch. context is passed through unchanged; jobIndex runs from 0 to numJobs - 1.
+    using Job = void (*) (void* context, int jobIndex);
+
+    ~RealtimeWorkerPool()
+    {
+        stop();
+    }
+
+    // Starts numWorkers threads, stopping any running ones first. They are scheduled as real-time threads that work for
+    // part of every block of samplesPerBlock samples, or at the highest normal priority where that is not allowed.
+    // Not real-time safe, and must not overlap run().
+    void start(int numWorkers, int samplesPerBlock, double sampleRate)
+    {
+        stop();
+
+        auto numCpus = juce::jmax(1, juce::SystemStats::getNumCpus());
+        auto options = juce::Thread::RealtimeOptions{}.withApproximateAudioProcessingTime(samplesPerBlock, sampleRate);
+        for (int i = 0; i < numWorkers; ++i)
+        {
+            workers.push_back(std::make_unique<Worker>(*this, i));
+            workers.back()->setAffinityMask(1u << ((i + 1) % juce::jmin(numCpus, 32))); // leave the first core to the host
+            if (! workers.back()->startRealtimeThread(options))
+                workers.back()->startThread(juce::Thread::Priority::highest);
+        }
+    }
+
+    // Stops and joins all workers. Not real-time safe, and must not overlap run().
+    void stop()
+    {
+        for (auto& worker : workers)
+            worker->signalThreadShouldExit();
+        for (auto& worker : workers)
+        {
+            worker->wake();
+            worker->stopThread(1000);
+        }
+        workers.clear();
+    }
+
+    int getNumWorkers() const
+    {
+        return (int) workers.size();
+    }
+
+    // Runs job(context, 0) ... job(context, numJobs - 1) and returns when all have finished
+    void run(int numJobs, Job job, void* context)
+    {
+        if (workers.empty())
+        {
+            for (int i = 0; i < numJobs; ++i)
+                job(context, i);
+            return;
+        }
+
+        // Publish the batch; the new ticket releases it to the workers
+        auto batch = getBatch(ticket.load()) + 1;
+        batchJob.store(job, std::memory_order_relaxed);
+        batchContext.store(context, std::memory_order_relaxed);
+        batchSize.store(numJobs, std::memory_order_relaxed);
+        jobsRemaining.store(numJobs, std::memory_order_relaxed);
+        ticket.store((juce::uint64) batch << 32);
+
+        for (auto& worker : workers)
+            if (worker->isSleeping.load())
+                worker->wake();
+
+        workOnBatch(batch);
+
+        // Barrier: wait for the jobs the workers took, which are already running
+        while (jobsRemaining.load(std::memory_order_acquire) > 0)
+            pause();
+    }
+
+private:
+    class Worker : public juce::Thread
+    {
+    public:
+        Worker(RealtimeWorkerPool& ownerPool, int index)
+            : juce::Thread("Layer worker " + juce::String(index + 1)), pool(ownerPool)
+        {
+        }
+
+        void wake()
+        {
+            wakeEvent.signal();
+        }
+
+        void run() override
+        {
+            auto seenBatch = getBatch(pool.ticket.load());
+
+            while (! threadShouldExit())
+            {
+                // Batches come once per block, so there is nothing to gain from spinning until the next one
+                if (getBatch(pool.ticket.load()) == seenBatch)
+                {
+                    isSleeping = true;
+                    if (getBatch(pool.ticket.load()) == seenBatch && ! threadShouldExit())
+                        wakeEvent.wait(100);
+                    isSleeping = false;
+                    continue;
+                }
+
+                seenBatch = getBatch(pool.ticket.load());
+                pool.workOnBatch(seenBatch);
+            }
+        }
+
+        std::atomic<bool> isSleeping { false };
+
+    private:
+        RealtimeWorkerPool& pool;
+        juce::WaitableEvent wakeEvent;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    std::atomic<Job> batchJob { nullptr };
+    std::atomic<void*> batchContext { nullptr };
+    std::atomic<int> batchSize { 0 };
+    std::atomic<int> jobsRemaining { 0 };
+    std::atomic<juce::uint64> ticket { 0 };   // batch number in the high 32 bits, next job index in the low 32 bits
+
+    static juce::uint32 getBatch(juce::uint64 ticketValue)
+    {
+        return (juce::uint32) (ticketValue >> 32);
+    }
+
+    // Tells the core that the thread is waiting in a loop, without giving up its time slice
+    static void pause()
+    {
+       #if JUCE_INTEL
+        _mm_pause();
+       #elif JUCE_ARM && (JUCE_GCC || JUCE_CLANG)
+        __asm__ __volatile__ ("yield");
+       #endif
+    }
+
+    // Takes jobs from a batch until it has none left or a newer batch has been published
+    void workOnBatch(juce::uint32 batch)
+    {
+        auto current = ticket.load();
+        for (;;)
+        {
+            auto index = (int) (current & 0xffffffff);
+            if (getBatch(current) != batch || index >= batchSize.load(std::memory_order_relaxed))
+                return;
+
+            // Claim the index; on failure current is reloaded and checked again
+            if (ticket.compare_exchange_weak(current, current + 1))
+            {
+                batchJob.load(std::memory_order_relaxed)(batchContext.load(std::memory_order_relaxed), index);
+                jobsRemaining.fetch_sub(1, std::memory_order_release);
+                current = ticket.load();
+            }
+        }
+    }
+};
@@ -0,0 +1,90 @@
+/*
+  ==============================================================================
+
+    RestGate.h
+    Created: 17 Oct 2026 11:36:52pm
+    Author:  70
+
+  ==============================================================================
+*/
+#pragma once
+
+#include <JuceHeader.h>
+#include <cmath>
+
+/**
+    Lets a voice fall silent and stop rendering while its frequency is 0 Hz, the rest marker of the note sequences.
+
+    A voice passes every new frequency to setFrequency(), and scales its oscillator output by getNextGain() before filtering it. At a rest the gain fades to zero over fadeTime, and the voice's filters ring out on silence. The voice passes the largest value held in its filter state to shouldGoIdle(), not its output: the filters are underdamped, so their ringing crosses zero, and a quiet output sample says nothing about the energy still stored. Once the state has fallen below the threshold, shouldGoIdle() returns true once so the voice can clear its filters, and from then on isIdle() tells the voice to return 0 without rendering anything. The next note wakes the voice with the gain at zero and fades it back in, so the output is continuous in both directions.
+*/
+class RestGate
+{
+public:
+    static constexpr float fadeTime = 0.005f;      // seconds to fade out into a rest, and back in after it
+    static constexpr float threshold = 1.0e-5f;    // -100 dB, below which the filters count as rung out
+
+    // Sets the sample rate used for the fade time
+    void setSampleRate(float SR)
+    {
+        step = 1.0f / juce::jmax(1.0f, fadeTime * SR);
+    }
+
+    // Takes the voice's new frequency; 0 Hz (or less) starts a rest, anything else ends it
+    void setFrequency(float Freq)
+    {
+        isResting = Freq <= 0.0f;
+        if (! isResting)
+            idle = false;
+    }
+
+    // True while the voice is resting and silent, so it can skip rendering
+    bool isIdle() const
+    {
+        return idle;
+    }
+
+    // True from the start of a rest until the voice goes idle. Only rendering tells when that is.
+    bool isFadingOut() const
+    {
+        return isResting && ! idle;
+    }
+
+    // Moves the gain on by numSamples outside a rest, as if getNextGain() had been called that often
+    void skip(juce::int64 numSamples)
+    {
+        jassert(! isResting);
+        gain = (float) juce::jmin(1.0, gain + (double) numSamples * step);
+    }
+
+    // Returns to the state before the first note: silent, but not idle
+    void reset()
+    {
+        gain = 0.0f;
+        isResting = false;
+        idle = false;
+    }
+
+    // Gain to apply to the oscillators for the next sample
+    float getNextGain()
+    {
+        gain = isResting ? juce::jmax(0.0f, gain - step) : juce::jmin(1.0f, gain + step);
+        return gain;
+    }
+
+    // Takes the largest magnitude in the voice's filter state, and returns true when the voice has faded out and its
+    // filters have rung out, i.e. when it should clear them. isIdle() is true from then until the next note.
+    bool shouldGoIdle(float filterState)
+    {
+        if (! isResting || gain > 0.0f || filterState >= threshold)
+            return false;
+
+        idle = true;
+        return true;
+    }
+
+private:
+    float step = 1.0f / (fadeTime * 44100.0f);
+    float gain = 0.0f;
+    bool isResting = false;
+    bool idle = false;
+};
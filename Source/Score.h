@@ -0,0 +1,301 @@
+/*
+  ==============================================================================
+
+    Score.h
+    Created: 18 Oct 2026 4:38:45am
+    Author:  70
+
+  ==============================================================================
+*/
+#pragma once
+
+#include <JuceHeader.h>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <type_traits>
+
+/**
+    A long composition in a compact binary file, memory-mapped so it can be played without parsing or allocating.
+
+    A score has named layers, each a list of events that a FrequencySelector of the same name plays in a loop. An event holds one frequency, a rest (0 Hz) or a random choice between several frequencies for a number of holds, i.e. multiples of the layer's hold duration, so the hold parameters still set the tempo. load() maps the file and checks it once; after that, getLayer() hands out views straight into the mapped memory, and playing them is only indexing into arrays. convertText() writes the binary format from a text description.
+
+    The file is little-endian and made of 4-byte fields, in this order:
+        header:       "WICS", version, number of layers, number of events, number of frequencies
+        layers:       name (32 bytes of UTF-8, padded with zeros), first event, number of events
+        events:       holds (float), first frequency, number of frequencies (1 for a note or a rest, more for a choice)
+        frequencies:  in Hz (float), 0 for a rest
+*/
+class Score
+{
+public:
+    static constexpr juce::uint32 currentVersion = 1;
+    static constexpr int maxNameLength = 32;
+
+    struct Event
+    {
+        float holds;                        // how long the event lasts, in holds of its layer
+        juce::uint32 firstFrequency;        // index of its first frequency in the score's frequencies
+        juce::uint32 numFrequencies;        // 1 for a note or a rest, more to choose one at random
+    };
+    static_assert(sizeof(Event) == 12 && std::is_trivially_copyable<Event>::value, "Events are read straight from the file");
+
+    // The events of one layer, pointing into the mapped file. Empty when a score has no such layer.
+    struct Layer
+    {
+        const Event* events = nullptr;
+        int numEvents = 0;
+        const float* frequencies = nullptr;
+    };
+
+    // Maps a score file and checks all of it, so that playing it needs no further checks. On failure returns what is
+    // wrong with the file and keeps the score that was loaded before. Not real-time safe.
+    juce::Result load(const juce::File& file)
+    {
+        if (juce::ByteOrder::isBigEndian())
+            return juce::Result::fail("scores can only be read on little-endian machines");
+
+        auto newFile = std::make_unique<juce::MemoryMappedFile>(file, juce::MemoryMappedFile::readOnly);
+        if (newFile->getData() == nullptr)
+            return juce::Result::fail("cannot map " + file.getFullPathName());
+
+        auto* data = static_cast<const char*>(newFile->getData());
+        auto size = newFile->getSize();
+        if (size < sizeof(Header))
+            return juce::Result::fail("the file is too short for a score");
+
+        auto* header = reinterpret_cast<const Header*>(data);
+        if (std::memcmp(header->magic, "WICS", 4) != 0)
+            return juce::Result::fail("the file is not a score");
+        if (header->version != currentVersion)
+            return juce::Result::fail("score version " + juce::String((int) header->version) + " is not supported");
+
+        auto expectedSize = (juce::uint64) sizeof(Header) + (juce::uint64) header->numLayers * sizeof(LayerEntry)
+                          + (juce::uint64) header->numEvents * sizeof(Event) + (juce::uint64) header->numFrequencies * sizeof(float);
+        if (size != expectedSize || header->numEvents > (juce::uint32) std::numeric_limits<int>::max())
+            return juce::Result::fail("the size of the file does not match its header");
+
+        auto* layers = reinterpret_cast<const LayerEntry*>(data + sizeof(Header));
+        auto* events = reinterpret_cast<const Event*>(layers + header->numLayers);
+        auto* frequencies = reinterpret_cast<const float*>(events + header->numEvents);
+
+        for (juce::uint32 i = 0; i < header->numLayers; ++i)
+        {
+            auto& layer = layers[i];
+            if (layer.name[maxNameLength - 1] != 0 || layer.numEvents == 0
+                || (juce::uint64) layer.firstEvent + layer.numEvents > header->numEvents)
+                return juce::Result::fail("layer " + juce::String((int) i) + " is not valid");
+        }
+
+        for (juce::uint32 i = 0; i < header->numEvents; ++i)
+        {
+            auto& event = events[i];
+            if (! std::isfinite(event.holds) || event.holds <= 0.0f || event.numFrequencies == 0
+                || (juce::uint64) event.firstFrequency + event.numFrequencies > header->numFrequencies)
+                return juce::Result::fail("event " + juce::String((int) i) + " is not valid");
+        }
+
+        for (juce::uint32 i = 0; i < header->numFrequencies; ++i)
+            if (! std::isfinite(frequencies[i]) || frequencies[i] < 0.0f)
+                return juce::Result::fail("frequency " + juce::String((int) i) + " is not valid");
+
+        mappedFile = std::move(newFile);
+        return juce::Result::ok();
+    }
+
+    // Number of layers, 0 before a score is loaded
+    int getNumLayers() const
+    {
+        return mappedFile != nullptr ? (int) getHeader().numLayers : 0;
+    }
+
+    juce::String getLayerName(int index) const
+    {
+        return juce::String::fromUTF8(getLayerEntries()[index].name);
+    }
+
+    // Returns the layer with a name, or an empty one when there is none
+    Layer getLayer(const juce::String& name) const
+    {
+        Layer layer;
+        for (int i = 0; i < getNumLayers(); ++i)
+        {
+            if (getLayerName(i) != name)
+                continue;
+
+            auto& entry = getLayerEntries()[i];
+            auto* events = reinterpret_cast<const Event*>(getLayerEntries() + getHeader().numLayers);
+            layer.events = events + entry.firstEvent;
+            layer.numEvents = (int) entry.numEvents;
+            layer.frequencies = reinterpret_cast<const float*>(events + getHeader().numEvents);
+            break;
+        }
+        return layer;
+    }
+
+    // Writes a score in the binary format from a text description. Each line is empty, a comment starting with #, or:
+    //     layer <name>                            starts the layer with that name, e.g. stringMotif
+    //     note <frequency> [for <holds>]          a note; the frequency is in Hz or a note name such as A4, C#5 or Eb3
+    //     rest [for <holds>]                      a rest
+    //     choose <frequency>... [for <holds>]     one of the frequencies, chosen at random each time it is played
+    // Events last one hold unless given for how many. Returns the line that is not valid, if any. Not real-time safe.
+    static juce::Result convertText(const juce::String& text, juce::MemoryBlock& destination)
+    {
+        juce::StringArray names;
+        juce::Array<LayerEntry> layers;
+        juce::Array<Event> events;
+        juce::Array<float> frequencies;
+
+        auto lines = juce::StringArray::fromLines(text);
+        for (int lineIndex = 0; lineIndex < lines.size(); ++lineIndex)
+        {
+            auto fail = [lineIndex] (const juce::String& message)
+            {
+                return juce::Result::fail("line " + juce::String(lineIndex + 1) + ": " + message);
+            };
+
+            // A comment runs from a word that starts with # to the end of the line, so C#5 is still a note
+            juce::StringArray tokens;
+            tokens.addTokens(lines[lineIndex], " \t", "");
+            tokens.removeEmptyStrings();
+            for (int i = 0; i < tokens.size(); ++i)
+                if (tokens[i].startsWithChar('#'))
+                    tokens.removeRange(i, tokens.size() - i);
+            if (tokens.isEmpty())
+                continue;
+
+            auto keyword = tokens[0];
+            if (keyword == "layer")
+            {
+                auto name = tokens[1];
+                if (tokens.size() != 2 || name.getNumBytesAsUTF8() >= (size_t) maxNameLength || names.contains(name))
+                    return fail("a layer needs a new name of less than " + juce::String(maxNameLength) + " bytes");
+
+                LayerEntry layer {};
+                name.copyToUTF8(layer.name, (size_t) maxNameLength);
+                layer.firstEvent = (juce::uint32) events.size();
+                layers.add(layer);
+                names.add(name);
+                continue;
+            }
+
+            if (layers.isEmpty())
+                return fail("events must follow a layer line");
+
+            // The duration comes last, after the frequencies
+            Event event { 1.0f, (juce::uint32) frequencies.size(), 0 };
+            auto numValues = tokens.size() - 1;
+            if (tokens.size() >= 3 && tokens[tokens.size() - 2] == "for")
+            {
+                event.holds = tokens[tokens.size() - 1].getFloatValue();
+                numValues -= 2;
+                if (! (event.holds > 0.0f))
+                    return fail("an event must last longer than 0 holds");
+            }
+
+            if (keyword == "rest" && numValues == 0)
+            {
+                frequencies.add(0.0f);
+            }
+            else if ((keyword == "note" && numValues == 1) || (keyword == "choose" && numValues >= 1))
+            {
+                for (int i = 1; i <= numValues; ++i)
+                {
+                    auto frequency = parseFrequency(tokens[i]);
+                    if (frequency < 0.0f)
+                        return fail("\"" + tokens[i] + "\" is not a frequency or a note name");
+                    frequencies.add(frequency);
+                }
+            }
+            else
+            {
+                return fail("expected layer, note, rest or choose");
+            }
+
+            event.numFrequencies = (juce::uint32) frequencies.size() - event.firstFrequency;
+            events.add(event);
+            ++layers.getReference(layers.size() - 1).numEvents;
+        }
+
+        for (int i = 0; i < layers.size(); ++i)
+            if (layers[i].numEvents == 0)
+                return juce::Result::fail("layer " + names[i] + " has no events");
+
+        juce::MemoryOutputStream stream (destination, false);
+        stream.write("WICS", 4);
+        stream.writeInt((int) currentVersion);
+        stream.writeInt(layers.size());
+        stream.writeInt(events.size());
+        stream.writeInt(frequencies.size());
+        for (auto& layer : layers)
+        {
+            stream.write(layer.name, (size_t) maxNameLength);
+            stream.writeInt((int) layer.firstEvent);
+            stream.writeInt((int) layer.numEvents);
+        }
+        for (auto& event : events)
+        {
+            stream.writeFloat(event.holds);
+            stream.writeInt((int) event.firstFrequency);
+            stream.writeInt((int) event.numFrequencies);
+        }
+        for (auto frequency : frequencies)
+            stream.writeFloat(frequency);
+        return juce::Result::ok();
+    }
+
+private:
+    struct Header
+    {
+        char magic[4];
+        juce::uint32 version;
+        juce::uint32 numLayers;
+        juce::uint32 numEvents;
+        juce::uint32 numFrequencies;
+    };
+
+    struct LayerEntry
+    {
+        char name[maxNameLength];
+        juce::uint32 firstEvent;
+        juce::uint32 numEvents;
+    };
+
+    std::unique_ptr<juce::MemoryMappedFile> mappedFile;
+
+    const Header& getHeader() const
+    {
+        return *static_cast<const Header*>(mappedFile->getData());
+    }
+
+    const LayerEntry* getLayerEntries() const
+    {
+        return reinterpret_cast<const LayerEntry*>(static_cast<const char*>(mappedFile->getData()) + sizeof(Header));
+    }
+
+    // Reads a frequency in Hz, 0 for a rest, or a note name such as A4, C#5 or Eb3. Returns -1 if it is neither.
+    static float parseFrequency(const juce::String& token)
+    {
+        if (token.containsOnly("0123456789."))
+            return token.getFloatValue();
+
+        auto letter = juce::String("C D EF G A B").indexOfChar(token[0]);
+        if (letter < 0 || token.length() < 2)
+            return -1.0f;
+
+        auto semitone = letter;
+        auto octave = token.substring(1);
+        if (octave[0] == '#' || octave[0] == 'b')
+        {
+            semitone += octave[0] == '#' ? 1 : -1;
+            octave = octave.substring(1);
+        }
+        if (octave.isEmpty() || ! octave.containsOnly("-0123456789"))
+            return -1.0f;
+
+        // MIDI note 69 is A4 at 440 Hz
+        auto midiNote = (octave.getIntValue() + 1) * 12 + semitone;
+        return 440.0f * std::pow(2.0f, (float) (midiNote - 69) / 12.0f);
+    }
+};
@@ -0,0 +1,149 @@
+/*
+  ==============================================================================
+
+    StageProfiler.h
+    Created: 17 Oct 2026 5:37:14pm
+    Author:  70
+
+  ==============================================================================
+*/
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+
+/**
+    Measures how much of the real-time budget each stage of processBlock() takes, without locking or allocating.
+
+    The audio thread marks the start of a block with beginBlock(), calls lap() after each stage to charge the time since the previous mark to that stage, and publishes the block with endBlock(). Timings come from juce::Time::getHighResolutionTicks(), so one lap costs a single clock read. They are accumulated in atomics that any other thread, typically the editor's timer, collects with getSnapshot(). When profiling is disabled, every call returns straight away.
+*/
+template <int NumStages>
+class StageProfiler
+{
+public:
+    // Cost of a stage as a fraction of the real-time budget (1 = all of it)
+    struct Load
+    {
+        float average = 0.0f;    // over all blocks since the previous snapshot
+        float peak = 0.0f;       // in the worst block since the previous snapshot
+    };
+
+    struct Snapshot
+    {
+        std::array<Load, NumStages> stages;
+        Load total;
+        juce::int64 numBlocks = 0;
+    };
+
+    // Turns profiling on or off. Safe to call from any thread.
+    void setEnabled(bool shouldBeEnabled)
+    {
+        enabled = shouldBeEnabled;
+    }
+
+    bool isEnabled() const
+    {
+        return enabled.load();
+    }
+
+    // Sets the sample rate used to turn block lengths into time budgets
+    void setSampleRate(double SR)
+    {
+        sampleRate = SR;
+    }
+
+    // Audio thread: starts timing a block
+    void beginBlock()
+    {
+        isTimingBlock = enabled.load(std::memory_order_relaxed);
+        if (! isTimingBlock)
+            return;
+
+        blockTicks.fill(0);
+        lastMark = blockStart = juce::Time::getHighResolutionTicks();
+    }
+
+    // Audio thread: charges the time since the previous mark to stage
+    void lap(int stage)
+    {
+        if (! isTimingBlock)
+            return;
+
+        auto now = juce::Time::getHighResolutionTicks();
+        blockTicks[stage] += now - lastMark;
+        lastMark = now;
+    }
+
+    // Audio thread: publishes the timings of a block of numSamples samples
+    void endBlock(int numSamples)
+    {
+        if (! isTimingBlock || numSamples <= 0)
+            return;
+
+        auto budgetTicks = (double) numSamples / sampleRate.load(std::memory_order_relaxed) * ticksPerSecond;
+
+        for (int stage = 0; stage < NumStages; ++stage)
+        {
+            stageTicks[stage].fetch_add(blockTicks[stage], std::memory_order_relaxed);
+            raisePeak(stagePeaks[stage], (float) (blockTicks[stage] / budgetTicks));
+        }
+
+        raisePeak(totalPeak, (float) ((lastMark - blockStart) / budgetTicks));
+        totalTicks.fetch_add(lastMark - blockStart, std::memory_order_relaxed);
+        totalSamples.fetch_add(numSamples, std::memory_order_relaxed);
+        totalBlocks.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Returns the load of every stage since the previous call and starts a new measurement.
+    // Meant for a single reader, e.g. the message thread.
+    Snapshot getSnapshot()
+    {
+        Snapshot snapshot;
+        auto numSamples = totalSamples.exchange(0);
+        snapshot.numBlocks = totalBlocks.exchange(0);
+
+        auto budgetTicks = (double) numSamples / sampleRate.load() * ticksPerSecond;
+        auto toLoad = [budgetTicks] (juce::int64 ticks) { return budgetTicks > 0.0 ? (float) (ticks / budgetTicks) : 0.0f; };
+
+        for (int stage = 0; stage < NumStages; ++stage)
+        {
+            snapshot.stages[stage].average = toLoad(stageTicks[stage].exchange(0));
+            snapshot.stages[stage].peak = stagePeaks[stage].exchange(0.0f);
+        }
+
+        snapshot.total.average = toLoad(totalTicks.exchange(0));
+        snapshot.total.peak = totalPeak.exchange(0.0f);
+        return snapshot;
+    }
+
+private:
+    static_assert(std::atomic<juce::int64>::is_always_lock_free, "The counters are updated on the audio thread");
+
+    const double ticksPerSecond = (double) juce::Time::getHighResolutionTicksPerSecond();
+
+    std::atomic<bool> enabled { false };
+    std::atomic<double> sampleRate { 44100.0 };
+
+    // Shared with the reader
+    std::array<std::atomic<juce::int64>, NumStages> stageTicks {};
+    std::array<std::atomic<float>, NumStages> stagePeaks {};
+    std::atomic<juce::int64> totalTicks { 0 };
+    std::atomic<float> totalPeak { 0.0f };
+    std::atomic<juce::int64> totalSamples { 0 };
+    std::atomic<juce::int64> totalBlocks { 0 };
+
+    // Owned by the audio thread
+    std::array<juce::int64, NumStages> blockTicks {};
+    juce::int64 blockStart = 0;
+    juce::int64 lastMark = 0;
+    bool isTimingBlock = false;
+
+    static void raisePeak(std::atomic<float>& peak, float value)
+    {
+        auto current = peak.load(std::memory_order_relaxed);
+        while (value > current && ! peak.compare_exchange_weak(current, value, std::memory_order_relaxed))
+        {
+        }
+    }
+};
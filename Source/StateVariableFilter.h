@@ -0,0 +1,135 @@
+/*
+  ==============================================================================
+
+    StateVariableFilter.h
+    Created: 17 Oct 2026 11:20:37am
+    Author:  70
+
+  ==============================================================================
+*/
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <cmath>
+
+/**
+    A topology-preserving-transform state variable filter that can be modulated every sample.
+
+    StateVariableFilter has the same low-pass and high-pass responses as the RBJ biquads made by juce::IIRCoefficients, but its state survives coefficient changes, so the cutoff can be swept per sample or per control block without clicks. The frequency warping tan(pi * f / fs) is read from a shared precomputed table, so setCutOff() costs one table lookup and one division. Initialize with setSampleRate(), choose the response with setType() and setResonance(), then call processSample() for each sample.
+*/
+class StateVariableFilter
+{
+public:
+    // Defines which output of the filter is returned
+    enum class Type
+    {
+        LowPass,
+        HighPass,
+        BandPass
+    };
+
+    // Sets the sample rate and recalculates the coefficients
+    void setSampleRate(float SR)
+    {
+        sampleRate = SR;
+        getWarpTable(); // build the shared table here rather than on the audio thread
+        updateCoefficients();
+    }
+
+    // Sets the filter response
+    void setType(Type newType)
+    {
+        type = newType;
+    }
+
+    // Sets the resonance as a Q factor, matching the Q argument of juce::IIRCoefficients
+    void setResonance(float Q)
+    {
+        k = 1.0f / juce::jmax(0.01f, Q);
+        updateCoefficients();
+    }
+
+    // Sets the cutoff frequency in Hz. Cheap enough to call every sample.
+    void setCutOff(float CutOffFreq)
+    {
+        cutOff = CutOffFreq;
+        updateCoefficients();
+    }
+
+    // Clears the filter state
+    void reset()
+    {
+        ic1eq = 0.0f;
+        ic2eq = 0.0f;
+    }
+
+    // Returns the largest magnitude held by the two integrators, which with no input bounds the ringing still to come
+    float getStateMagnitude() const
+    {
+        return juce::jmax(std::abs(ic1eq), std::abs(ic2eq));
+    }
+
+    // Processes a single sample through the filter
+    float processSample(float input)
+    {
+        auto v3 = input - ic2eq;
+        auto v1 = a1 * ic1eq + a2 * v3;
+        auto v2 = ic2eq + a2 * ic1eq + a3 * v3;
+        ic1eq = 2.0f * v1 - ic1eq;
+        ic2eq = 2.0f * v2 - ic2eq;
+
+        switch (type)
+        {
+            case Type::LowPass:  return v2;
+            case Type::HighPass: return input - k * v1 - v2;
+            case Type::BandPass: return v1;
+        }
+        return v2;
+    }
+
+    // Returns the prewarped gain tan(pi * f / fs) from the shared table, for filters that keep their own state
+    static float getWarpedGain(float CutOffFreq, float SR)
+    {
+        auto& table = getWarpTable();
+        auto normalised = juce::jlimit(0.0f, maxNormalisedCutOff, CutOffFreq / SR);
+        auto position = normalised * (warpTableSize / maxNormalisedCutOff);
+        auto index = juce::jmin((int) position, warpTableSize - 1);
+        auto frac = position - (float) index;
+        return table[index] + frac * (table[index + 1] - table[index]);
+    }
+
+private:
+    static constexpr int warpTableSize = 1024;
+    static constexpr float maxNormalisedCutOff = 0.49f; // cutoff limit as a fraction of the sample rate
+
+    Type type = Type::LowPass;
+    float sampleRate = 44100.0f;
+    float cutOff = 1000.0f;
+    float k = 1.41421356f;       // damping, 1 / Q
+    float a1 = 0.0f, a2 = 0.0f, a3 = 0.0f;
+    float ic1eq = 0.0f, ic2eq = 0.0f;
+
+    // tan(pi * x) for x in [0, maxNormalisedCutOff], with one guard point for interpolation
+    static const std::array<float, warpTableSize + 1>& getWarpTable()
+    {
+        static const auto table = []
+        {
+            std::array<float, warpTableSize + 1> t {};
+            for (int i = 0; i < (int) t.size(); ++i)
+                t[i] = (float) std::tan(juce::MathConstants<double>::pi * maxNormalisedCutOff * i / warpTableSize);
+            return t;
+        }();
+        return table;
+    }
+
+    // Recalculates the coefficients from the cutoff, without any trigonometric calls
+    void updateCoefficients()
+    {
+        auto g = getWarpedGain(cutOff, sampleRate);
+
+        a1 = 1.0f / (1.0f + g * (g + k));
+        a2 = g * a1;
+        a3 = g * a2;
+    }
+};
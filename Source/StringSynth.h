@@ -6,12 +6,13 @@
 #define StringSynth_h
 
 #include "Oscillators.h"
+#include "RestGate.h"
 #include <JuceHeader.h>
 
 /**
     Crafts rich, resonant string sounds with vibrato and low-pass filtering.
 
-    StringSynth combines square and saw oscillators, enhanced by vibrato via an LFO, and shaped with a low-pass filter for classic string timbres. It offers detailed control over oscillator mix, pulse width, and vibrato depth. Initialize with setSampleRate(), customize the sound with oscillator and filter settings, then use process() to generate the output. Ideal for emulating vintage string machines and creating modern string sounds.
+    StringSynth combines band-limited square and saw oscillators, enhanced by vibrato via an LFO, and shaped with a low-pass filter for classic string timbres. It offers detailed control over oscillator mix, pulse width, and vibrato depth. Initialize with setSampleRate(), customize the sound with oscillator and filter settings, then use process() to generate the output. Ideal for emulating vintage string machines and creating modern string sounds.
  */
 class StringSynth
 {
@@ -28,14 +29,22 @@ public:
         squareOsc.setSampleRate(sampleRate);
         sawOsc.setSampleRate(sampleRate);
         vibratoLFO.setSampleRate(sampleRate);
+        restGate.setSampleRate(sampleRate);
     }
 
-    // Sets the base frequency for the oscillators
+    // Sets the base frequency for the oscillators; 0 Hz is a rest, during which the synth fades out and goes idle
     void setFrequency(float Freq)
     {
+        // The vibrato keeps time through a rest, so it catches up on the samples spent idle
+        if (Freq > 0.0f && idleSamples > 0)
+        {
+            vibratoLFO.skip(idleSamples);
+            idleSamples = 0;
+        }
         baseFrequency = Freq;
         squareOsc.setFrequency(baseFrequency);
         sawOsc.setFrequency(baseFrequency);
+        restGate.setFrequency(baseFrequency);
     }
 
     // Sets the vibrato LFO frequency
@@ -70,9 +79,24 @@ public:
         VibratoAmount = VibratoAmt;
     }
     
+    // Keeps the phases of the oscillators and the LFO in fixed point, so they do not drift over long runs
+    void setFixedPointPhase(bool shouldUseFixedPoint)
+    {
+        squareOsc.setFixedPointPhase(shouldUseFixedPoint);
+        sawOsc.setFixedPointPhase(shouldUseFixedPoint);
+        vibratoLFO.setFixedPointPhase(shouldUseFixedPoint);
+    }
+    
     // Processes the audio signal, applying vibrato and filtering
     float process()
     {
+        // Nothing to render while resting
+        if (restGate.isIdle())
+        {
+            ++idleSamples;
+            return 0.0f;
+        }
+        
         // Calculate the vibrato effect
         //auto vibratoVal = vibratoLFO.process();
         auto vibratoEffect = vibratoLFO.process() * VibratoAmount; // LFO output modulates around 0
@@ -87,16 +111,78 @@ public:
         auto sawWave = sawOsc.process();
         
         // Mix the two waveforms. Adjust the mixing ratio as needed.
-        auto mixedWave = (squareWave * SquareAmount) + (sawWave * SawAmount);
+        auto mixedWave = ((squareWave * SquareAmount) + (sawWave * SawAmount)) * restGate.getNextGain();
 
         // Process the mixed wave through the filter
-        return lowPassFilter.processSingleSampleRaw(mixedWave);
+        auto output = lowPassFilter.processSingleSampleRaw(mixedWave);
+        
+        // Once a rest has faded and the filter has rung out, clear its state and go idle
+        if (restGate.shouldGoIdle(lowPassFilter.getStateMagnitude()))
+            lowPassFilter.reset();
+        return output;
+    }
+    
+    // Moves on by numSamples without rendering them, as if process() had been called that often. The oscillators
+    // move in closed form and the filter keeps its state, so it needs a few milliseconds of rendering to settle.
+    // A fade into a rest is rendered. The stale filter may let the voice go idle a few samples early or late, but the
+    // vibrato keeps time through the rest either way.
+    void skip(juce::int64 numSamples)
+    {
+        for (; numSamples > 0 && restGate.isFadingOut(); --numSamples)
+            process();
+        
+        if (restGate.isIdle())
+            idleSamples += numSamples;
+        if (numSamples <= 0 || restGate.isIdle())
+            return;
+        
+        // Every sample runs the oscillators at baseFrequency * (1 + vibrato * VibratoAmount), so over the skip they
+        // move by the number of samples plus the sum of the vibrato, scaled. Without vibrato, every sample takes the
+        // same step, and the oscillators take them so that a fixed-point phase lands exactly where it would.
+        auto vibratoSum = vibratoLFO.sumOfNextSamples(numSamples) * VibratoAmount;
+        vibratoLFO.skip(numSamples);
+        squareOsc.setFrequency(baseFrequency);
+        sawOsc.setFrequency(baseFrequency);
+        if (vibratoSum == 0.0)
+        {
+            squareOsc.skip(numSamples);
+            sawOsc.skip(numSamples);
+        }
+        else
+        {
+            auto cycles = (double) baseFrequency / sampleRate * ((double) numSamples + vibratoSum);
+            squareOsc.skipCycles(cycles);
+            sawOsc.skipCycles(cycles);
+        }
+        restGate.skip(numSamples);
+    }
+    
+    // Returns the oscillators, filter and rest gate to their state before the first sample
+    void reset()
+    {
+        squareOsc.reset();
+        sawOsc.reset();
+        vibratoLFO.reset();
+        lowPassFilter.reset();
+        restGate.reset();
+        idleSamples = 0;
     }
 private:
-    SquareOsc squareOsc;
-    SawOsc sawOsc;
+    // juce::IIRFilter with its history exposed, so a rest can tell when the filter has rung out
+    struct LowPassFilter : juce::IIRFilter
+    {
+        float getStateMagnitude() const
+        {
+            return juce::jmax(std::abs(v1), std::abs(v2));
+        }
+    };
+
+    PolyBlepSquareOsc squareOsc;
+    PolyBlepSawOsc sawOsc;
     SinOsc vibratoLFO;
-    juce::IIRFilter lowPassFilter;
+    LowPassFilter lowPassFilter;
+    RestGate restGate;
+    juce::int64 idleSamples = 0;  // samples spent idle in the current rest
     
     float sampleRate = 44100.0f;
     float baseFrequency = 440.0f;
@@ -16,7 +16,7 @@
 /**
     Generates deep subbass sounds with versatile modulation and filtering options.
 
-    Subbass synthesizes low-frequency audio using square and saw oscillators, enriched with vibrato and detune effects, and shaped by a low-pass filter for smooth textures. Configure it with setSampleRate() and setFrequency(), then modulate with vibrato, detune, and filter settings to craft rich basslines. The process() method outputs the final mixed and filtered audio signal, suitable for electronic music production.
+    Subbass synthesizes low-frequency audio using band-limited square and saw oscillators, enriched with vibrato and detune effects, and shaped by a low-pass filter for smooth textures. Configure it with setSampleRate() and setFrequency(), then modulate with vibrato, detune, and filter settings to craft rich basslines. The process() method outputs the final mixed and filtered audio signal, suitable for electronic music production.
 */
 class Subbass
 {
@@ -35,6 +35,7 @@ public:
         vibratoLFO.setSampleRate(sampleRate);
         detuneFine.setSampleRate(sampleRate);
         detuneCoarse.setSampleRate(sampleRate);
+        updateFilter(filterCutOff); // the filter coefficients depend on the sample rate
     }
 
     // Sets the base frequency for the oscillators
@@ -92,6 +93,16 @@ public:
         VibratoAmount = VibratoAmt;
     }
     
+    // Keeps the phases of all oscillators and the LFO in fixed point, so they do not drift over long runs
+    void setFixedPointPhase(bool shouldUseFixedPoint)
+    {
+        squareOsc.setFixedPointPhase(shouldUseFixedPoint);
+        sawOsc.setFixedPointPhase(shouldUseFixedPoint);
+        detuneFine.setFixedPointPhase(shouldUseFixedPoint);
+        detuneCoarse.setFixedPointPhase(shouldUseFixedPoint);
+        vibratoLFO.setFixedPointPhase(shouldUseFixedPoint);
+    }
+    
     // Processes the audio signal, generating the subbass output
     float process()
     {
@@ -113,12 +124,47 @@ public:
         // Process the mixed wave through the filter
         return lowPassFilter.processSingleSampleRaw(mixedWave);
     }
+    
+    // Moves on by numSamples without rendering them, as if process() had been called that often. The oscillators
+    // move in closed form and the filter keeps its state, so it needs a few milliseconds of rendering to settle.
+    void skip(juce::int64 numSamples)
+    {
+        // The vibrato of the square and saw adds up over the skip in closed form, as in StringSynth
+        auto vibratoSum = vibratoLFO.sumOfNextSamples(numSamples) * VibratoAmount;
+        vibratoLFO.skip(numSamples);
+        squareOsc.setFrequency(baseFrequency);
+        sawOsc.setFrequency(baseFrequency);
+        if (vibratoSum == 0.0)
+        {
+            squareOsc.skip(numSamples);
+            sawOsc.skip(numSamples);
+        }
+        else
+        {
+            auto cycles = (double) baseFrequency / sampleRate * ((double) numSamples + vibratoSum);
+            squareOsc.skipCycles(cycles);
+            sawOsc.skipCycles(cycles);
+        }
+        detuneFine.skip(numSamples);
+        detuneCoarse.skip(numSamples);
+    }
+    
+    // Returns the oscillators and filter to their state before the first sample
+    void reset()
+    {
+        squareOsc.reset();
+        sawOsc.reset();
+        detuneFine.reset();
+        detuneCoarse.reset();
+        vibratoLFO.reset();
+        lowPassFilter.reset();
+    }
 private:
     // Oscillators and LFO
-    SquareOsc squareOsc;
-    SawOsc sawOsc;
-    SawOsc detuneFine;
-    SawOsc detuneCoarse;
+    PolyBlepSquareOsc squareOsc;
+    PolyBlepSawOsc sawOsc;
+    PolyBlepSawOsc detuneFine;
+    PolyBlepSawOsc detuneCoarse;
     SinOsc vibratoLFO;
     
     // Filter
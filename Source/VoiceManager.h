@@ -0,0 +1,294 @@
+/*
+  ==============================================================================
+
+    VoiceManager.h
+    Created: 17 Oct 2026 3:05:51pm
+    Author:  70
+
+  ==============================================================================
+*/
+#pragma once
+
+#include "PadSynthBank.h"
+#include <JuceHeader.h>
+#include <array>
+
+/**
+    Plays MIDI notes on a fixed pool of pad voices.
+
+    VoiceManager owns a preallocated PadSynthBank and maps note-on and note-off messages onto its lanes. A free voice is used when there is one; otherwise the oldest releasing voice is stolen, then the oldest held one. Stolen voices glide from their current level and phase to the new note instead of restarting, so stealing does not click. Every voice has a linear attack and release, and voices that have finished releasing are skipped by the bank, so an idle pool costs no CPU. Nothing is allocated after construction. Initialize with setSampleRate(), feed MIDI with handleMidiMessage() and call advance() as the samples between the messages pass, and call process() to render the voices. Handling a message only picks the voices and queues what happens to them at the time it arrived; process() applies the queued commands when it reaches their time. So the messages of a block can be handled before any of it is rendered, and rendered on another thread, as long as the two never run at once. A voice goes back to the pool once its release time has passed.
+*/
+class VoiceManager
+{
+public:
+    static constexpr int maxVoices = 16;
+
+    // The gain to mix the voices with: a four-note chord comes out as loud as the built-in chords, which leaves the
+    // sum of all maxVoices voices at most four times that
+    static constexpr float outputGain = 0.25f;
+
+    // Commands one message queues at most: an all-notes-off releases every voice
+    static constexpr int maxCommandsPerMessage = maxVoices;
+
+    VoiceManager()
+    {
+        allNotesOff();
+    }
+
+    // Sets the sample rate for all voices
+    void setSampleRate(float SR)
+    {
+        sampleRate = SR;
+        voices.setSampleRate(sampleRate);
+    }
+
+    // Sets the phase modulation LFO frequency of all voices
+    void setLFOFrequency(float LFOFreq)
+    {
+        voices.setLFOFrequency(LFOFreq);
+    }
+
+    // Sets the phase modulation depth of all voices
+    void setLFOAmount(float LFOAmt)
+    {
+        voices.setLFOAmount(LFOAmt);
+    }
+
+    // Sets the low-pass cutoff of all voices
+    void setFilterCutOff(float CutOffFreq)
+    {
+        voices.setFilterCutOff(CutOffFreq);
+    }
+
+    // Keeps the phases of all voices in fixed point, so they do not drift over long runs
+    void setFixedPointPhase(bool shouldUseFixedPoint)
+    {
+        voices.setFixedPointPhase(shouldUseFixedPoint);
+    }
+
+    // Limits how many voices new notes may use, to save CPU. Voices beyond the limit are released and fade out.
+    void setNumVoicesInUse(int numVoices)
+    {
+        numVoicesInUse = juce::jlimit(1, maxVoices, numVoices);
+        for (int v = numVoicesInUse; v < maxVoices; ++v)
+            if (voiceNote[v] >= 0 && ! voiceIsReleasing[v])
+                releaseVoice(v);
+    }
+
+    int getNumVoicesInUse() const noexcept { return numVoicesInUse; }
+
+    // Dispatches note-on, note-off and all-notes-off messages
+    void handleMidiMessage(const juce::MidiMessage& message)
+    {
+        if (message.isNoteOn())
+            noteOn(message.getNoteNumber(), message.getFloatVelocity());
+        else if (message.isNoteOff())
+            noteOff(message.getNoteNumber());
+        else if (message.isAllNotesOff() || message.isAllSoundOff())
+            releaseAllVoices();
+    }
+
+    // Starts a note on a free voice, or steals one
+    void noteOn(int noteNumber, float velocity)
+    {
+        auto voice = findVoiceToPlay();
+        auto frequency = (float) juce::MidiMessage::getMidiNoteInHertz(noteNumber);
+
+        queueCommand({ messageTime, voice, true, frequency, velocity, int (attackSeconds * sampleRate) });
+        voiceNote[voice] = noteNumber;
+        voiceIsReleasing[voice] = false;
+        voiceStartOrder[voice] = ++startCounter;
+    }
+
+    // Releases every voice playing this note
+    void noteOff(int noteNumber)
+    {
+        for (int v = 0; v < maxVoices; ++v)
+            if (voiceNote[v] == noteNumber && ! voiceIsReleasing[v])
+                releaseVoice(v);
+    }
+
+    // Releases all sounding voices
+    void releaseAllVoices()
+    {
+        for (int v = 0; v < maxVoices; ++v)
+            if (voiceNote[v] >= 0 && ! voiceIsReleasing[v])
+                releaseVoice(v);
+    }
+
+    // Silences all voices immediately and returns them to the pool, dropping the queued commands. Rendering catches up
+    // with the messages, so call it only while the voices are not being rendered.
+    void allNotesOff()
+    {
+        for (int v = 0; v < maxVoices; ++v)
+        {
+            voices.setVoiceGain(v, 0.0f, 0);
+            voiceNote[v] = -1;
+            voiceIsReleasing[v] = false;
+            voiceStartOrder[v] = 0;
+        }
+        numCommands = nextCommand = 0;
+        renderTime = messageTime;
+    }
+
+    // Moves the time of the messages on by numSamples; the voices whose release ends by then go back to the pool
+    void advance(int numSamples)
+    {
+        messageTime += numSamples;
+        for (int v = 0; v < maxVoices; ++v)
+            if (voiceIsReleasing[v] && messageTime >= releaseEndTime[v])
+            {
+                voiceNote[v] = -1;
+                voiceIsReleasing[v] = false;
+            }
+    }
+
+    // Whether the queue has room for the commands of another message, which it then applies at their exact time.
+    // A message beyond that still plays, but its commands, or older ones, can apply early. Call only while the voices
+    // are not being rendered.
+    bool hasRoomForMessage()
+    {
+        compactCommands();
+        return numCommands + maxCommandsPerMessage <= maxCommands;
+    }
+
+    // Renders numSamples samples, writing the sum of all voices to out. The queued commands apply at their time.
+    void process(float* out, int numSamples)
+    {
+        for (int start = 0; start < numSamples;)
+        {
+            auto length = applyDueCommands(numSamples - start);
+            voices.process(out + start, length);
+            renderTime += length;
+            start += length;
+        }
+    }
+
+    // Moves on by numSamples without rendering them, as if process() had been called for them
+    void skip(int numSamples)
+    {
+        for (int start = 0; start < numSamples;)
+        {
+            auto length = applyDueCommands(numSamples - start);
+            voices.skip(length);
+            renderTime += length;
+            start += length;
+        }
+    }
+
+    // Returns the frequency of the lowest held note, or fallback when no note is held
+    float getLowestFrequency(float fallback) const
+    {
+        int lowestNote = 128;
+        for (int v = 0; v < maxVoices; ++v)
+            if (voiceNote[v] >= 0 && ! voiceIsReleasing[v])
+                lowestNote = juce::jmin(lowestNote, voiceNote[v]);
+        return lowestNote < 128 ? (float) juce::MidiMessage::getMidiNoteInHertz(lowestNote) : fallback;
+    }
+
+private:
+    // A change of one voice at a time of the messages: a note starting, or a release
+    struct Command
+    {
+        juce::int64 time;
+        int voice;
+        bool startsNote;    // sets the frequency first, from a clean state if the voice is silent
+        float frequency;
+        float gain;         // ramped to over rampSamples
+        int rampSamples;
+    };
+
+    static constexpr int maxCommands = 256;
+
+    PadSynthBank<maxVoices> voices;
+
+    int voiceNote[maxVoices];              // MIDI note of each voice, -1 when the voice is free
+    bool voiceIsReleasing[maxVoices];      // true between note-off and the end of the release
+    juce::int64 releaseEndTime[maxVoices] {}; // when the release of each releasing voice ends
+    juce::uint32 voiceStartOrder[maxVoices]; // when each voice was started, for stealing the oldest
+    juce::uint32 startCounter = 0;
+
+    // Commands in order of time; those from nextCommand on have not been applied yet
+    std::array<Command, maxCommands> commands;
+    int numCommands = 0;
+    int nextCommand = 0;
+    juce::int64 messageTime = 0;    // the time of the messages, moved on by advance()
+    juce::int64 renderTime = 0;     // the time of the next sample process() renders
+
+    float sampleRate = 44100.0f;
+    float attackSeconds = 1.0f;  // pad-like fade in
+    float releaseSeconds = 2.0f; // pad-like fade out
+    int numVoicesInUse = maxVoices;  // voices new notes may take, the first ones of the pool
+
+    void releaseVoice(int voice)
+    {
+        auto releaseSamples = int (releaseSeconds * sampleRate);
+        queueCommand({ messageTime, voice, false, 0.0f, 0.0f, releaseSamples });
+        voiceIsReleasing[voice] = true;
+        releaseEndTime[voice] = messageTime + releaseSamples;
+    }
+
+    void queueCommand(const Command& command)
+    {
+        compactCommands();
+        if (numCommands == maxCommands)
+            applyCommand(commands[(size_t) nextCommand++]); // full: the oldest command applies early
+        compactCommands();
+        commands[(size_t) numCommands++] = command;
+    }
+
+    // Moves the commands that have not been applied yet to the front of the queue
+    void compactCommands()
+    {
+        if (nextCommand == 0)
+            return;
+        std::copy(commands.begin() + nextCommand, commands.begin() + numCommands, commands.begin());
+        numCommands -= nextCommand;
+        nextCommand = 0;
+    }
+
+    void applyCommand(const Command& command)
+    {
+        if (command.startsNote)
+        {
+            if (voices.getVoiceGain(command.voice) <= 0.0f)
+                voices.resetVoice(command.voice); // a silent voice starts from a clean state
+            voices.setFrequency(command.voice, command.frequency);
+        }
+        voices.setVoiceGain(command.voice, command.gain, command.rampSamples);
+    }
+
+    // Applies the commands that are due, and returns how many of the next numSamples samples pass before the next one
+    int applyDueCommands(int numSamples)
+    {
+        for (; nextCommand < numCommands && commands[(size_t) nextCommand].time <= renderTime; ++nextCommand)
+            applyCommand(commands[(size_t) nextCommand]);
+
+        if (nextCommand < numCommands)
+            return (int) juce::jmin((juce::int64) numSamples, commands[(size_t) nextCommand].time - renderTime);
+        return numSamples;
+    }
+
+    // Picks a free voice, else the oldest releasing voice, else the oldest held voice
+    int findVoiceToPlay() const
+    {
+        for (int v = 0; v < numVoicesInUse; ++v)
+            if (voiceNote[v] < 0)
+                return v;
+
+        int oldestReleasing = -1, oldestHeld = 0;
+        for (int v = 0; v < numVoicesInUse; ++v)
+        {
+            if (voiceIsReleasing[v])
+            {
+                if (oldestReleasing < 0 || voiceStartOrder[v] < voiceStartOrder[oldestReleasing])
+                    oldestReleasing = v;
+            }
+            else if (voiceStartOrder[v] < voiceStartOrder[oldestHeld])
+            {
+                oldestHeld = v;
+            }
+        }
+        return oldestReleasing >= 0 ? oldestReleasing : oldestHeld;
+    }
+};